@@ -0,0 +1,223 @@
+// per frame cost of the old filter path against PacketClassifier
+//
+// the old path ran a "net a or net b" bpf program compiled without
+// optimisation, then parsed the frame again at fixed offsets. frames are
+// kept in memory so only filtering and parsing are timed. the mix holds
+// both feeds plain, with an 802.1Q tag and with ip options, plus traffic of
+// other nets and protocols. a second run takes the plain feed frames alone
+#include "../src/pcap/packet_classifier.h"
+
+#include <pcap.h>
+
+#include <chrono>
+#include <cstring>
+#include <iostream>
+#include <string>
+#include <vector>
+
+#include <net/ethernet.h>
+#include <netinet/ip.h>
+
+namespace {
+struct Frame {
+  pcap_pkthdr header;
+  std::vector<u_char> data;
+};
+
+Frame make_frame(const char *source, const char *dest, uint8_t protocol,
+                 bool vlan, uint32_t ip_options, uint32_t payload_size) {
+  Frame frame;
+  size_t link = sizeof(ether_header) + (vlan ? 4 : 0);
+  size_t ip_length = sizeof(ip) + ip_options;
+  frame.data.resize(link + ip_length + sizeof(udphdr) + payload_size);
+  u_char *p = frame.data.data();
+
+  uint16_t type = htons(ETHERTYPE_IP);
+  if (vlan) {
+    uint16_t tpid = htons(ETHERTYPE_VLAN);
+    uint16_t tci = htons(100);
+    memcpy(p + 12, &tpid, 2);
+    memcpy(p + 14, &tci, 2);
+    memcpy(p + 16, &type, 2);
+  } else {
+    memcpy(p + 12, &type, 2);
+  }
+
+  auto *ip_header = reinterpret_cast<ip *>(p + link);
+  ip_header->ip_v = 4;
+  ip_header->ip_hl = ip_length / 4;
+  ip_header->ip_p = protocol;
+  ip_header->ip_len = htons(frame.data.size() - link);
+  inet_aton(source, &ip_header->ip_src);
+  inet_aton(dest, &ip_header->ip_dst);
+  memset(p + link + sizeof(ip), 1 /*nop*/, ip_options);
+
+  auto *udp_header = reinterpret_cast<udphdr *>(p + link + ip_length);
+  udp_header->len = htons(sizeof(udphdr) + payload_size);
+  udp_header->dest = htons(5261);
+
+  frame.header.caplen = frame.data.size();
+  frame.header.len = frame.data.size();
+  return frame;
+}
+
+// PcapReader::parse_packet() before the classifier
+int fixed_offset_parse(const u_char *packet, uint32_t caplen,
+                       const std::vector<UdpPacketProcessor> &feeds,
+                       UdpPacket &udp_packet) {
+  auto *ethernet_header = reinterpret_cast<const ether_header *>(packet);
+  if (ntohs(ethernet_header->ether_type) != ETHERTYPE_IP) {
+    return -1;
+  }
+  auto *ip_header = reinterpret_cast<const ip *>(packet + sizeof(ether_header));
+  if (ip_header->ip_p != IPPROTO_UDP) {
+    return -1;
+  }
+  for (size_t i = 0; i < feeds.size(); ++i) {
+    if (feeds[i].match(ip_header->ip_src)) {
+      const size_t offset = sizeof(ether_header) + sizeof(ip) + sizeof(udphdr);
+      auto *udp_header = reinterpret_cast<const udphdr *>(
+          packet + sizeof(ether_header) + sizeof(ip));
+      udp_packet.payload = packet + offset;
+      udp_packet.captured = caplen > offset ? caplen - offset : 0;
+      udp_packet.length = ntohs(udp_header->len);
+      udp_packet.source_port = ntohs(udp_header->source);
+      udp_packet.dest_port = ntohs(udp_header->dest);
+      udp_packet.source = ip_header->ip_src;
+      return i;
+    }
+  }
+  return -1;
+}
+
+// best of a few runs over all frames, in nano seconds per frame
+template <typename Classify>
+double measure(const std::vector<Frame> &frames, uint32_t rounds,
+               uint64_t &matched, Classify classify) {
+  double best = 0;
+  for (int run = 0; run < 3; ++run) {
+    matched = 0;
+    auto start = std::chrono::steady_clock::now();
+    for (uint32_t round = 0; round < rounds; ++round) {
+      for (const auto &frame : frames) {
+        UdpPacket packet;
+        matched += classify(frame, packet) >= 0;
+      }
+    }
+    auto elapsed = std::chrono::steady_clock::now() - start;
+    double ns = std::chrono::duration<double, std::nano>(elapsed).count() /
+                (static_cast<double>(rounds) * frames.size());
+    if (run == 0 || ns < best) {
+      best = ns;
+    }
+  }
+  return best;
+}
+} // namespace
+
+int main(int argc, char *argv[]) {
+  uint32_t rounds = argc > 1 ? std::stoul(argv[1]) : 2000;
+  const char *filter = "net 172.27.1 or net 172.27.129";
+
+  // weights roughly like a capture port: mostly feed packets
+  std::vector<Frame> frames;
+  for (int i = 0; i < 64; ++i) {
+    const char *source = i % 2 == 0 ? "172.27.1.10" : "172.27.129.10";
+    switch (i % 8) {
+    case 6:
+      frames.push_back(
+          make_frame("10.0.0.1", "10.0.0.2", IPPROTO_UDP, false, 0, 200));
+      break;
+    case 7:
+      frames.push_back(
+          make_frame(source, "10.0.0.2", IPPROTO_TCP, false, 0, 200));
+      break;
+    default:
+      frames.push_back(make_frame(source, "239.1.1.1", IPPROTO_UDP, i % 8 == 4,
+                                  i % 8 == 5 ? 8 : 0, 200));
+    }
+  }
+
+  std::vector<UdpPacketProcessor> feeds;
+  feeds.emplace_back("172.27.1.0", "255.255.255.0");
+  feeds.emplace_back("172.27.129.0", "255.255.255.0");
+  PacketClassifier classifier;
+  for (const auto &feed : feeds) {
+    classifier.add_feed(feed.net(), feed.netmask());
+  }
+
+  std::cout << frames.size() << " frames x " << rounds << " rounds\n";
+  uint64_t matched = 0;
+  double fixed = measure(frames, rounds, matched,
+                         [&](const Frame &frame, UdpPacket &packet) {
+                           return fixed_offset_parse(frame.data.data(),
+                                                     frame.header.caplen,
+                                                     feeds, packet);
+                         });
+  std::cout << "fixed offsets:         " << fixed << " ns/frame, "
+            << matched << " matched\n";
+
+  // bpf needs a real libpcap
+  pcap_t *dead = pcap_open_dead(DLT_EN10MB, 65535);
+  for (int optimize = 0; dead != nullptr && optimize < 2; ++optimize) {
+    bpf_program program;
+    if (pcap_compile(dead, &program, filter, optimize, PCAP_NETMASK_UNKNOWN) !=
+        0) {
+      std::cout << "bpf: " << pcap_geterr(dead) << '\n';
+      break;
+    }
+    double ns = measure(frames, rounds, matched,
+                        [&](const Frame &frame, UdpPacket &packet) {
+                          if (pcap_offline_filter(&program, &frame.header,
+                                                  frame.data.data()) == 0) {
+                            return -1;
+                          }
+                          return fixed_offset_parse(frame.data.data(),
+                                                    frame.header.caplen,
+                                                    feeds, packet);
+                        });
+    std::cout << "bpf -O" << optimize << " + fixed offsets: " << ns
+              << " ns/frame, " << matched << " matched\n";
+    pcap_freecode(&program);
+  }
+  if (dead == nullptr) {
+    std::cout << "bpf: no pcap_open_dead()\n";
+  } else {
+    pcap_close(dead);
+  }
+
+  double native = measure(frames, rounds, matched,
+                          [&](const Frame &frame, UdpPacket &packet) {
+                            return classifier.classify(frame.data.data(),
+                                                       frame.header.caplen,
+                                                       packet);
+                          });
+  std::cout << "PacketClassifier:      " << native << " ns/frame, "
+            << matched << " matched\n";
+
+  // plain feed frames only, which the fixed offsets parse correctly and
+  // PacketClassifier takes its fast path for
+  std::vector<Frame> plain;
+  for (size_t i = 0; i < frames.size(); ++i) {
+    if (i % 8 < 4) {
+      plain.push_back(frames[i]);
+    }
+  }
+  std::cout << plain.size() << " plain frames x " << rounds << " rounds\n";
+  fixed = measure(plain, rounds, matched,
+                  [&](const Frame &frame, UdpPacket &packet) {
+                    return fixed_offset_parse(frame.data.data(),
+                                              frame.header.caplen, feeds,
+                                              packet);
+                  });
+  std::cout << "fixed offsets:         " << fixed << " ns/frame, "
+            << matched << " matched\n";
+  native = measure(plain, rounds, matched,
+                   [&](const Frame &frame, UdpPacket &packet) {
+                     return classifier.classify(frame.data.data(),
+                                                frame.header.caplen, packet);
+                   });
+  std::cout << "PacketClassifier:      " << native << " ns/frame, "
+            << matched << " matched\n";
+  return 0;
+}
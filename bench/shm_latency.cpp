@@ -0,0 +1,81 @@
+// publisher -> subscriber latency over the shared memory ring
+//
+// the parent process publishes trade events stamped with CLOCK_MONOTONIC,
+// a forked child subscribes and reports latency percentiles
+#include "../src/shm/broadcast_ring.h"
+
+#include <algorithm>
+#include <iostream>
+#include <string>
+#include <vector>
+
+#include <sched.h>
+#include <sys/wait.h>
+#include <time.h>
+#include <unistd.h>
+
+static uint64_t now_ns() {
+  timespec ts;
+  clock_gettime(CLOCK_MONOTONIC, &ts);
+  return ts.tv_sec * 1000000000ULL + ts.tv_nsec;
+}
+
+static int subscribe(const std::string &name, uint64_t count) {
+  shm::Subscriber subscriber(name);
+  std::vector<uint64_t> latencies;
+  latencies.reserve(count);
+
+  shm::Record record;
+  while (latencies.size() + subscriber.lost() < count) {
+    switch (subscriber.poll(record)) {
+    case shm::Subscriber::Status::Ok:
+      latencies.push_back(now_ns() - record.pcap_ts);
+      break;
+    case shm::Subscriber::Status::Empty:
+      sched_yield();
+      break;
+    case shm::Subscriber::Status::Overrun:
+      break;
+    }
+  }
+
+  std::sort(latencies.begin(), latencies.end());
+  auto percentile = [&](double p) {
+    return latencies.empty() ? 0 : latencies[(latencies.size() - 1) * p];
+  };
+  std::cout << "received " << latencies.size() << ", lost "
+            << subscriber.lost() << '\n'
+            << "latency ns: p50 " << percentile(0.5) << ", p99 "
+            << percentile(0.99) << ", p99.9 " << percentile(0.999)
+            << ", max " << percentile(1.0) << '\n';
+  return 0;
+}
+
+int main(int argc, char *argv[]) {
+  uint64_t count = argc > 1 ? std::stoull(argv[1]) : 1000000;
+  // gap between two publishes, to measure latency rather than throughput
+  uint64_t interval_ns = argc > 2 ? std::stoull(argv[2]) : 1000;
+  std::string name = "pcap_udp_shm_latency";
+
+  shm::Publisher publisher(name, 1 << 16);
+
+  pid_t pid = fork();
+  if (pid == 0) {
+    return subscribe(name, count);
+  }
+
+  // give the subscriber some time to attach
+  usleep(100000);
+  md::TradeEvent trade{};
+  for (uint64_t i = 0; i < count; i++) {
+    trade.appl_seq_num = i;
+    uint64_t start = now_ns();
+    publisher.publish(trade, start, i);
+    while (now_ns() - start < interval_ns) {
+    }
+  }
+
+  int status = 0;
+  waitpid(pid, &status, 0);
+  return WEXITSTATUS(status);
+}
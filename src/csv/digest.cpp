@@ -0,0 +1,145 @@
+#include "digest.h"
+
+#include <algorithm>
+#include <iomanip>
+#include <set>
+#include <sstream>
+#include <vector>
+
+using namespace csv;
+
+namespace {
+// one round of xxhash64
+inline uint64_t fold(uint64_t state, uint64_t value) {
+  state += value * 0xc2b2ae3d27d4eb4fULL;
+  state = (state << 31) | (state >> 33);
+  return state * 0x9e3779b185ebca87ULL;
+}
+
+struct Checkpoint {
+  uint64_t records;
+  uint64_t first_key;
+  uint64_t last_key;
+  std::string digest;
+};
+
+// key: stream, channel
+using Checkpoints =
+    std::map<std::pair<std::string, uint32_t>, std::vector<Checkpoint>>;
+
+Checkpoints read_checkpoints(std::istream &is) {
+  Checkpoints checkpoints;
+  std::string line;
+  while (std::getline(is, line)) {
+    std::stringstream ss(line);
+    std::string stream, channel, records, first_key, last_key, digest;
+    if (!std::getline(ss, stream, ',') || !std::getline(ss, channel, ',') ||
+        !std::getline(ss, records, ',') || !std::getline(ss, first_key, ',') ||
+        !std::getline(ss, last_key, ',') || !std::getline(ss, digest, ',') ||
+        stream == "stream") {
+      continue;
+    }
+    checkpoints[std::make_pair(stream, std::stoul(channel))].push_back(
+        Checkpoint{std::stoull(records), std::stoull(first_key),
+                   std::stoull(last_key), digest});
+  }
+  return checkpoints;
+}
+
+void print_region(std::ostream &os, uint64_t from, const Checkpoint *point) {
+  if (point == nullptr) {
+    os << "missing";
+    return;
+  }
+  os << "records " << from + 1 << '-' << point->records << ", keys "
+     << point->first_key << '-' << point->last_key;
+}
+} // namespace
+
+void Digest::add(uint32_t channel_id, uint64_t key, const int64_t *fields,
+                 size_t count) {
+  auto &channel = channels_[channel_id];
+  uint64_t state = channel.state;
+  for (size_t i = 0; i < count; i++) {
+    state = fold(state, fields[i]);
+  }
+  channel.state = state;
+  if (channel.pending == 0) {
+    channel.first_key = key;
+  }
+  channel.last_key = key;
+  channel.records += 1;
+  channel.pending += 1;
+  if (channel.pending == interval_) {
+    checkpoint(channel_id, channel);
+  }
+}
+
+void Digest::flush() {
+  for (auto &kv : channels_) {
+    if (kv.second.pending != 0) {
+      checkpoint(kv.first, kv.second);
+    }
+  }
+  std::unique_lock<std::mutex> lock;
+  if (out_mutex_ != nullptr) {
+    lock = std::unique_lock<std::mutex>(*out_mutex_);
+  }
+  out_.flush();
+}
+
+void Digest::checkpoint(uint32_t channel_id, Channel &channel) {
+  std::ostringstream line;
+  line << stream_ << ',' << channel_id << ',' << channel.records << ','
+       << channel.first_key << ',' << channel.last_key << ',' << std::hex
+       << std::setfill('0') << std::setw(16) << channel.state << '\n';
+  channel.pending = 0;
+
+  std::unique_lock<std::mutex> lock;
+  if (out_mutex_ != nullptr) {
+    lock = std::unique_lock<std::mutex>(*out_mutex_);
+  }
+  out_ << line.str();
+}
+
+bool csv::compare_digests(std::istream &a, std::istream &b,
+                          std::ostream &report) {
+  Checkpoints left = read_checkpoints(a);
+  Checkpoints right = read_checkpoints(b);
+
+  // all streams and channels of either run
+  std::set<std::pair<std::string, uint32_t>> keys;
+  for (const auto &kv : left) {
+    keys.insert(kv.first);
+  }
+  for (const auto &kv : right) {
+    keys.insert(kv.first);
+  }
+
+  bool same = true;
+  for (const auto &key : keys) {
+    const auto &points_a = left[key];
+    const auto &points_b = right[key];
+    size_t n = std::max(points_a.size(), points_b.size());
+    uint64_t from = 0;
+    for (size_t i = 0; i < n; i++) {
+      const Checkpoint *point_a = i < points_a.size() ? &points_a[i] : nullptr;
+      const Checkpoint *point_b = i < points_b.size() ? &points_b[i] : nullptr;
+      if (point_a != nullptr && point_b != nullptr &&
+          point_a->records == point_b->records &&
+          point_a->digest == point_b->digest) {
+        from = point_a->records;
+        continue;
+      }
+      same = false;
+      report << key.first << " channel " << key.second
+             << " differs after " << from << " records: ";
+      print_region(report, from, point_a);
+      report << " vs ";
+      print_region(report, from, point_b);
+      report << '\n';
+      break;
+    }
+  }
+  return same;
+}
@@ -0,0 +1,69 @@
+#pragma once
+
+#include <cstdint>
+#include <initializer_list>
+#include <iostream>
+#include <map>
+#include <mutex>
+#include <string>
+
+namespace csv {
+// rolling digest of an output stream, one per channel
+//
+// records are folded in by their decoded fields, not the csv text, and
+// without capture time or packet index, so two runs over the same capture
+// agree unless the decoded content or the order within a channel differs.
+// every interval records of a channel a checkpoint line is written:
+//   stream,channel,records,firstKey,lastKey,digest
+// records counts from the start of the channel and the digest chains over
+// all of them, keys locate the region since the previous checkpoint, e.g.
+// appl seq nums. compare_digests() finds the first region two runs differ.
+class Digest {
+public:
+  // digests added to from different threads which share out also share
+  // out_mutex, a checkpoint line is written whole under it
+  Digest(std::string stream, uint32_t interval, std::ostream &out,
+         std::mutex *out_mutex = nullptr)
+      : stream_(stream), interval_(interval), out_(out),
+        out_mutex_(out_mutex) {}
+
+  ~Digest() { flush(); }
+
+  void add(uint32_t channel, uint64_t key, const int64_t *fields,
+           size_t count);
+
+  void add(uint32_t channel, uint64_t key,
+           std::initializer_list<int64_t> fields) {
+    add(channel, key, fields.begin(), fields.size());
+  }
+
+  // checkpoint what is left, e.g. at the end of a run
+  void flush();
+
+  static const char *header() {
+    return "stream,channel,records,firstKey,lastKey,digest";
+  }
+
+private:
+  struct Channel {
+    uint64_t state{0};
+    uint64_t records{0};
+    uint64_t first_key{0};
+    uint64_t last_key{0};
+    // records since the last checkpoint
+    uint32_t pending{0};
+  };
+
+  void checkpoint(uint32_t channel_id, Channel &channel);
+
+  std::string stream_;
+  uint32_t interval_;
+  std::ostream &out_;
+  std::mutex *out_mutex_;
+  std::map<uint32_t, Channel> channels_;
+};
+
+// compares checkpoint lines of two runs, reports the first differing region
+// of every stream and channel, returns whether both runs agree
+bool compare_digests(std::istream &a, std::istream &b, std::ostream &report);
+} // namespace csv
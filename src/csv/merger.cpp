@@ -0,0 +1,176 @@
+#include "merger.h"
+
+#include <iostream>
+#include <queue>
+#include <sstream>
+
+using namespace csv;
+
+namespace {
+std::vector<std::string> split_header(const std::string &header) {
+  std::vector<std::string> columns;
+  std::stringstream ss(header);
+  std::string column;
+  while (std::getline(ss, column, ',')) {
+    columns.push_back(column);
+  }
+  return columns;
+}
+
+int find_column(const std::vector<std::string> &columns,
+                const std::string &name) {
+  for (size_t i = 0; i < columns.size(); i++) {
+    if (columns[i] == name) {
+      return i;
+    }
+  }
+  return -1;
+}
+
+// returns the n-th field without allocating, fields never contain ','
+std::pair<const char *, size_t> field(const std::string &line, int n) {
+  size_t start = 0;
+  for (int i = 0; i < n; i++) {
+    start = line.find(',', start);
+    if (start == std::string::npos) {
+      return {line.data() + line.size(), 0};
+    }
+    start += 1;
+  }
+  size_t end = line.find(',', start);
+  if (end == std::string::npos) {
+    end = line.size();
+  }
+  return {line.data() + start, end - start};
+}
+
+uint64_t to_uint(std::pair<const char *, size_t> f) {
+  uint64_t value = 0;
+  for (size_t i = 0; i < f.second; i++) {
+    value = value * 10 + (f.first[i] - '0');
+  }
+  return value;
+}
+
+// numbers without leading zeros and fixed width times like 09:30:03.000
+// both order correctly by (length, lexical)
+bool greater(std::pair<const char *, size_t> f, const std::string &last) {
+  if (f.second != last.size()) {
+    return f.second > last.size();
+  }
+  return last.compare(0, last.size(), f.first, f.second) < 0;
+}
+} // namespace
+
+Merger::Merger(std::vector<std::string> inputs, std::string output,
+               size_t buffer_size)
+    : input_names_(inputs), output_name_(output), buffer_size_(buffer_size) {}
+
+bool Merger::advance(Input &input) {
+  if (!std::getline(input.file, input.line) || input.line.empty()) {
+    return false;
+  }
+  stats_.lines_read += 1;
+  input.clock = to_uint(field(input.line, clock_col_));
+  input.seq = to_uint(field(input.line, seq_col_));
+  return true;
+}
+
+bool Merger::is_duplicate(const std::string &line) {
+  if (group_col_ < 0 || order_col_ < 0) {
+    return false;
+  }
+  auto group = field(line, group_col_);
+  auto order = field(line, order_col_);
+  auto &last = last_written_[std::string(group.first, group.second)];
+  if (!last.empty() && !greater(order, last)) {
+    return true;
+  }
+  last.assign(order.first, order.second);
+  return false;
+}
+
+int Merger::merge() {
+  std::string header;
+  inputs_.resize(input_names_.size());
+  for (size_t i = 0; i < inputs_.size(); i++) {
+    Input &input = inputs_[i];
+    // a large buffer keeps reads sequential and big
+    input.buffer.reset(new char[buffer_size_]);
+    input.file.rdbuf()->pubsetbuf(input.buffer.get(), buffer_size_);
+    input.file.open(input_names_[i]);
+    std::string input_header;
+    if (!input.file || !std::getline(input.file, input_header)) {
+      std::cerr << "cannot read " << input_names_[i] << '\n';
+      return 1;
+    }
+    if (i == 0) {
+      header = input_header;
+    } else if (input_header != header) {
+      std::cerr << "header of " << input_names_[i] << " differs from "
+                << input_names_[0] << '\n';
+      return 1;
+    }
+  }
+
+  auto columns = split_header(header);
+  clock_col_ = find_column(columns, "clockAtArrival");
+  seq_col_ = find_column(columns, "sequenceNo");
+  if (clock_col_ < 0 || seq_col_ < 0) {
+    std::cerr << "missing clockAtArrival or sequenceNo column\n";
+    return 1;
+  }
+  group_col_ = find_column(columns, "ChannelNo");
+  order_col_ = find_column(columns, "ApplSeqNum");
+  if (group_col_ < 0 || order_col_ < 0) {
+    // snapshot
+    group_col_ = find_column(columns, "StockID");
+    order_col_ = find_column(columns, "time");
+  }
+
+  std::unique_ptr<char[]> out_buffer(new char[buffer_size_]);
+  std::ofstream out;
+  out.rdbuf()->pubsetbuf(out_buffer.get(), buffer_size_);
+  out.open(output_name_);
+  if (!out) {
+    std::cerr << "cannot write " << output_name_ << '\n';
+    return 1;
+  }
+  out << header << '\n';
+
+  // min heap on (clock, seq, input index)
+  auto later = [this](size_t a, size_t b) {
+    const Input &x = inputs_[a];
+    const Input &y = inputs_[b];
+    if (x.clock != y.clock) {
+      return x.clock > y.clock;
+    }
+    if (x.seq != y.seq) {
+      return x.seq > y.seq;
+    }
+    return a > b;
+  };
+  std::priority_queue<size_t, std::vector<size_t>, decltype(later)> heap(
+      later);
+  for (size_t i = 0; i < inputs_.size(); i++) {
+    if (advance(inputs_[i])) {
+      heap.push(i);
+    }
+  }
+
+  while (!heap.empty()) {
+    size_t idx = heap.top();
+    heap.pop();
+    Input &input = inputs_[idx];
+    if (is_duplicate(input.line)) {
+      stats_.duplicates += 1;
+    } else {
+      out << input.line << '\n';
+      stats_.lines_written += 1;
+    }
+    if (advance(input)) {
+      heap.push(idx);
+    }
+  }
+  return out ? 0 : 1;
+}
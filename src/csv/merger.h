@@ -0,0 +1,64 @@
+#pragma once
+
+#include <cstdint>
+#include <fstream>
+#include <memory>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+namespace csv {
+// streaming k-way merge of csv files written by csv::Writer
+//
+// every input shall already be ordered by (clockAtArrival, sequenceNo), which
+// holds for the per-pcap outputs. only one line per input is kept in memory,
+// ties are broken by input order.
+//
+// records repeated at file boundaries are dropped: orders and trades by
+// (ChannelNo, ApplSeqNum), snapshots by (StockID, time), keeping the first.
+class Merger {
+public:
+  struct Stats {
+    uint64_t lines_read{0};
+    uint64_t lines_written{0};
+    uint64_t duplicates{0};
+  };
+
+  // buffer_size is per file, memory use is about (inputs + 1) * buffer_size
+  Merger(std::vector<std::string> inputs, std::string output,
+         size_t buffer_size);
+
+  // returns 0 on success, error is printed to stderr otherwise
+  int merge();
+
+  const Stats &stats() const { return stats_; }
+
+private:
+  struct Input {
+    std::unique_ptr<char[]> buffer;
+    std::ifstream file;
+    std::string line;
+    uint64_t clock;
+    uint64_t seq;
+  };
+
+  bool advance(Input &input);
+  bool is_duplicate(const std::string &line);
+
+  std::vector<std::string> input_names_;
+  std::string output_name_;
+  size_t buffer_size_;
+
+  std::vector<Input> inputs_;
+
+  // column indexes, from the header
+  int clock_col_{-1};
+  int seq_col_{-1};
+  int group_col_{-1};
+  int order_col_{-1};
+  // key: ChannelNo or StockID, value: last ApplSeqNum or time written
+  std::unordered_map<std::string, std::string> last_written_;
+
+  Stats stats_;
+};
+} // namespace csv
@@ -1,64 +1,202 @@
 #include "writer.h"
 #include "../md/utils.h"
 
+#include <cstring>
+
 using namespace csv;
 
-void Writer::write_order(const md::Order &order, uint64_t pcap_ts,
+namespace {
+// security ids are 6 digits with leading zeros
+struct SecurityId {
+  uint32_t id;
+};
+
+std::ostream &operator<<(std::ostream &os, SecurityId security_id) {
+  return os << std::setfill('0') << std::setw(6) << security_id.id
+            << std::setfill(' ');
+}
+} // namespace
+
+Writer::Writer(std::string outputfile, std::string header,
+               io::CompressionPool *pool)
+    : csv_file_(nullptr) {
+  if (pool != nullptr) {
+    buffer_.reset(new io::GzipFrameBuffer(outputfile + ".gz", *pool));
+  } else {
+    auto *file = new std::filebuf;
+    file->open(outputfile, std::ios::out);
+    buffer_.reset(file);
+  }
+  csv_file_.rdbuf(buffer_.get());
+  csv_file_ << std::setprecision(6) << std::fixed;
+  csv_file_ << header << '\n';
+  message_text_ << std::setprecision(6) << std::fixed;
+}
+
+void Writer::write_order(const md::OrderEvent &order, uint64_t pcap_ts,
                          uint64_t pcap_seq) {
-  std::string security_id =
-      md::bytes_to_str(order.security_id, sizeof(order.security_id));
+  SecurityId security_id{order.security_id};
   csv_file_ << pcap_ts << ',' << pcap_seq << ",2,1,0,"
-            << order.transaction_time() % Writer::TIME_MULT << ','
-            << order.channel_no() << ',' << order.appl_seq_num() << ','
-            << security_id << ',' << "2" + security_id << ",24," << order.side
-            << ',' << order.order_type << ",-1," << order.price() << ','
-            << order.quantity() / Writer::QUANTITY_MULT << '\n';
+            << order.transaction_time % Writer::TIME_MULT << ','
+            << order.channel_no << ',' << order.appl_seq_num << ','
+            << security_id << ",2" << security_id << ",24," << order.side
+            << ',' << order.order_type << ",-1," << order.price << ','
+            << order.quantity / Writer::QUANTITY_MULT << '\n';
+  if (digest_ != nullptr) {
+    digest_->add(order.channel_no, order.appl_seq_num,
+                 {static_cast<int64_t>(order.appl_seq_num), order.security_id,
+                  order.transaction_time, order.side, order.order_type,
+                  order.price, order.quantity});
+  }
 }
 
-void Writer::write_trade(const md::Trade &trade, uint64_t pcap_ts,
+void Writer::write_trade(const md::TradeEvent &trade, uint64_t pcap_ts,
                          uint64_t pcap_seq) {
-  std::string security_id =
-      md::bytes_to_str(trade.security_id, sizeof(trade.security_id));
+  SecurityId security_id{trade.security_id};
   csv_file_ << pcap_ts << ',' << pcap_seq << ",2,1,0,"
-            << trade.transaction_time() % Writer::TIME_MULT << ','
-            << trade.channel_no() << ',' << trade.appl_seq_num() << ','
-            << security_id << ',' << "2" + security_id << ",24,"
-            << trade.execute_type << ",N,-1," << trade.price() << ','
-            << trade.quantity() / Writer::QUANTITY_MULT << ','
-            << trade.price() * trade.quantity() / Writer::QUANTITY_MULT << ','
-            << trade.bid_appl_seq_num() << ',' << trade.offer_appl_seq_num()
+            << trade.transaction_time % Writer::TIME_MULT << ','
+            << trade.channel_no << ',' << trade.appl_seq_num << ','
+            << security_id << ",2" << security_id << ",24,"
+            << trade.execute_type << ",N,-1," << trade.price << ','
+            << trade.quantity / Writer::QUANTITY_MULT << ','
+            << trade.price * trade.quantity / Writer::QUANTITY_MULT << ','
+            << trade.bid_appl_seq_num << ',' << trade.offer_appl_seq_num
             << '\n';
+  if (digest_ != nullptr) {
+    digest_->add(trade.channel_no, trade.appl_seq_num,
+                 {static_cast<int64_t>(trade.appl_seq_num), trade.security_id,
+                  trade.transaction_time, trade.execute_type, trade.price,
+                  trade.quantity,
+                  static_cast<int64_t>(trade.bid_appl_seq_num),
+                  static_cast<int64_t>(trade.offer_appl_seq_num)});
+  }
 }
 
-void Writer::write_snapshot(const md::SnapshotWrapper &snapshot,
+void Writer::write_snapshot(const md::SnapshotEvent &snapshot,
                             uint64_t pcap_ts, uint64_t pcap_seq, int depth) {
   // placeholders
   csv_file_ << "09:42:12.094767," << pcap_ts << ",23994," << pcap_ts << ','
-            << pcap_seq << ",24," << snapshot.security_id << ",SZ,"
-            << md::timestamp_to_string(snapshot.orig_time) << ','
+            << pcap_seq << ",24," << SecurityId{snapshot.security_id}
+            << ",SZ," << md::timestamp_to_string(snapshot.orig_time) << ','
             << snapshot.total_trade_volume / Writer::QUANTITY_MULT << ','
             << 1.0 * snapshot.total_trade_value / Writer::AMOUNT_MULT << ','
             << 1.0 * snapshot.latest_trade_price / Writer::MD_PRICE_MULT
             << ",0,";
 
-  for (int i = 1; i <= depth; i++) {
-    csv_file_ << 1.0 * snapshot.get_bid_level(i).price / Writer::MD_PRICE_MULT
-              << ',';
+  for (int i = 0; i < depth; i++) {
+    csv_file_ << 1.0 * snapshot.bids[i].price / Writer::MD_PRICE_MULT << ',';
   }
-  for (int i = 1; i <= depth; i++) {
-    csv_file_ << snapshot.get_bid_level(i).quantity / Writer::QUANTITY_MULT
-              << ',';
+  for (int i = 0; i < depth; i++) {
+    csv_file_ << snapshot.bids[i].quantity / Writer::QUANTITY_MULT << ',';
   }
 
-  for (int i = 1; i <= depth; i++) {
-    csv_file_ << 1.0 * snapshot.get_ask_level(i).price / Writer::MD_PRICE_MULT
-              << ',';
+  for (int i = 0; i < depth; i++) {
+    csv_file_ << 1.0 * snapshot.asks[i].price / Writer::MD_PRICE_MULT << ',';
   }
-  for (int i = 1; i <= depth; i++) {
-    csv_file_ << snapshot.get_ask_level(i).quantity / Writer::QUANTITY_MULT
-              << ',';
+  for (int i = 0; i < depth; i++) {
+    csv_file_ << snapshot.asks[i].quantity / Writer::QUANTITY_MULT << ',';
   }
 
   csv_file_ << 1.0 * snapshot.open_price / Writer::MD_PRICE_MULT << ','
             << snapshot.total_trade_num << '\n';
+  digest_snapshot(snapshot, depth);
+}
+
+void Writer::write_snapshot_delta(const md::SnapshotEvent &snapshot,
+                                  const md::SnapshotEvent *previous,
+                                  uint64_t pcap_ts, uint64_t pcap_seq,
+                                  int depth) {
+  // writes value and separator, or only the separator if unchanged
+  auto price = [&](int64_t value, int64_t last) {
+    if (previous == nullptr || value != last) {
+      csv_file_ << 1.0 * value / Writer::MD_PRICE_MULT;
+    }
+    csv_file_ << ',';
+  };
+  auto quantity = [&](int64_t value, int64_t last) {
+    if (previous == nullptr || value != last) {
+      csv_file_ << value / Writer::QUANTITY_MULT;
+    }
+    csv_file_ << ',';
+  };
+  const md::SnapshotEvent &last = previous == nullptr ? snapshot : *previous;
+
+  csv_file_ << "09:42:12.094767," << pcap_ts << ",23994," << pcap_ts << ','
+            << pcap_seq << ",24," << SecurityId{snapshot.security_id}
+            << ",SZ," << md::timestamp_to_string(snapshot.orig_time) << ',';
+  quantity(snapshot.total_trade_volume, last.total_trade_volume);
+  if (previous == nullptr ||
+      snapshot.total_trade_value != last.total_trade_value) {
+    csv_file_ << 1.0 * snapshot.total_trade_value / Writer::AMOUNT_MULT;
+  }
+  csv_file_ << ',';
+  price(snapshot.latest_trade_price, last.latest_trade_price);
+  csv_file_ << "0,";
+
+  for (int i = 0; i < depth; i++) {
+    price(snapshot.bids[i].price, last.bids[i].price);
+  }
+  for (int i = 0; i < depth; i++) {
+    quantity(snapshot.bids[i].quantity, last.bids[i].quantity);
+  }
+  for (int i = 0; i < depth; i++) {
+    price(snapshot.asks[i].price, last.asks[i].price);
+  }
+  for (int i = 0; i < depth; i++) {
+    quantity(snapshot.asks[i].quantity, last.asks[i].quantity);
+  }
+
+  price(snapshot.open_price, last.open_price);
+  if (previous == nullptr ||
+      snapshot.total_trade_num != last.total_trade_num) {
+    csv_file_ << snapshot.total_trade_num;
+  }
+  csv_file_ << ',' << (previous == nullptr ? 1 : 0) << '\n';
+  // same digest as the full row, so full and delta runs compare equal
+  digest_snapshot(snapshot, depth);
+}
+
+void Writer::digest_snapshot(const md::SnapshotEvent &snapshot, int depth) {
+  if (digest_ == nullptr) {
+    return;
+  }
+  int64_t fields[7 + 4 * md::SnapshotEvent::DEPTH];
+  size_t count = 0;
+  fields[count++] = snapshot.security_id;
+  fields[count++] = snapshot.orig_time;
+  fields[count++] = snapshot.total_trade_num;
+  fields[count++] = snapshot.total_trade_volume;
+  fields[count++] = snapshot.total_trade_value;
+  fields[count++] = snapshot.latest_trade_price;
+  fields[count++] = snapshot.open_price;
+  for (int i = 0; i < depth; i++) {
+    fields[count++] = snapshot.bids[i].price;
+    fields[count++] = snapshot.bids[i].quantity;
+    fields[count++] = snapshot.asks[i].price;
+    fields[count++] = snapshot.asks[i].quantity;
+  }
+  digest_->add(snapshot.channel_no, snapshot.orig_time, fields, count);
+}
+
+void Writer::write_bar(const md::Bar &bar) {
+  csv_file_ << SecurityId{bar.security_id} << ',' << bar.width_seconds << ','
+            << md::millis_to_exchange_time(bar.start_millis) << ','
+            << bar.open << ',' << bar.high << ',' << bar.low << ','
+            << bar.close << ',' << bar.volume / Writer::QUANTITY_MULT << ','
+            << bar.turnover << ',' << bar.vwap() << ',' << bar.trade_count
+            << '\n';
+  if (digest_ != nullptr) {
+    digest_->add(bar.width_seconds, bar.start_millis,
+                 {bar.security_id, bar.start_millis, bar.open, bar.high,
+                  bar.low, bar.close, bar.volume, bar.turnover,
+                  bar.trade_count});
+  }
+}
+
+void Writer::digest_text(uint32_t channel, uint64_t key,
+                         const std::string &text) {
+  // 8 characters a field, the last one padded with zeros
+  text_fields_.assign((text.size() + 7) / 8, 0);
+  std::memcpy(text_fields_.data(), text.data(), text.size());
+  digest_->add(channel, key, text_fields_.data(), text_fields_.size());
 }
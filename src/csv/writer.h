@@ -1,35 +1,85 @@
 #pragma once
 
-#include "../md/order.h"
-#include "../md/snapshot.h"
-#include "../md/trade.h"
+#include "../io/gzip_frames.h"
+#include "../md/bar.h"
+#include "../md/event.h"
+#include "digest.h"
 
 #include <fstream>
 #include <iomanip>
+#include <memory>
+#include <sstream>
+#include <string>
+#include <vector>
 
 namespace csv {
 
 class Writer {
 public:
-  explicit Writer(std::string outputfile, std::string header)
-      : csv_file_(outputfile) {
-    csv_file_ << std::setprecision(6) << std::fixed;
-    csv_file_ << header << '\n';
-  }
+  // with a pool, rows go to outputfile + ".gz" as independently compressed
+  // frames, see io::GzipFrameBuffer
+  Writer(std::string outputfile, std::string header,
+         io::CompressionPool *pool = nullptr);
 
-  void write_order(const md::Order &order, uint64_t pcap_ts, uint64_t pcap_seq);
+  void write_order(const md::OrderEvent &order, uint64_t pcap_ts,
+                   uint64_t pcap_seq);
 
-  void write_trade(const md::Trade &trade, uint64_t pcap_ts, uint64_t pcap_seq);
+  void write_trade(const md::TradeEvent &trade, uint64_t pcap_ts,
+                   uint64_t pcap_seq);
 
-  void write_snapshot(const md::SnapshotWrapper &snapshot, uint64_t pcap_ts,
+  void write_snapshot(const md::SnapshotEvent &snapshot, uint64_t pcap_ts,
                       uint64_t pcap_seq, int depth);
 
+  // fields equal to previous are left empty, previous == nullptr means a
+  // keyframe. a trailing keyframe column (1/0) is added
+  void write_snapshot_delta(const md::SnapshotEvent &snapshot,
+                            const md::SnapshotEvent *previous,
+                            uint64_t pcap_ts, uint64_t pcap_seq, int depth);
+
+  void write_bar(const md::Bar &bar);
+
+  // not owned, every row written is folded into it. bars are kept apart
+  // by bar width in place of the channel
+  void set_digest(Digest *digest) { digest_ = digest; }
+
+  // any message of md/schema.h, channel and key place it in the digest,
+  // e.g. its channel_no and orig_time
+  template <typename T>
+  void write_message(const T &message, uint32_t channel, uint64_t key,
+                     uint64_t pcap_ts, uint64_t pcap_seq) {
+    csv_file_ << pcap_ts << ',' << pcap_seq << ',';
+    if (digest_ == nullptr) {
+      message.write_csv(csv_file_);
+    } else {
+      message_text_.str(std::string());
+      message.write_csv(message_text_);
+      std::string text = message_text_.str();
+      csv_file_ << text;
+      digest_text(channel, key, text);
+    }
+    csv_file_ << '\n';
+  }
+
+  template <typename T> static std::string message_header() {
+    return "clockAtArrival,sequenceNo," + T::csv_header();
+  }
+
   static const int64_t TIME_MULT = 1000000000;
   static const int64_t PRICE_MULT = 10000;
   static const int64_t QUANTITY_MULT = 100;
   static const int64_t MD_PRICE_MULT = 1000000;
   static const int64_t AMOUNT_MULT = 10000; // cash
 private:
-  std::ofstream csv_file_;
+  void digest_snapshot(const md::SnapshotEvent &snapshot, int depth);
+  // schema messages have no fixed fields, their csv text is folded in
+  void digest_text(uint32_t channel, uint64_t key, const std::string &text);
+
+  // a std::filebuf or an io::GzipFrameBuffer
+  std::unique_ptr<std::streambuf> buffer_;
+  std::ostream csv_file_;
+  Digest *digest_{nullptr};
+  // reused by write_message and digest_text
+  std::ostringstream message_text_;
+  std::vector<int64_t> text_fields_;
 };
 } // namespace csv
@@ -0,0 +1,148 @@
+#include "logger.h"
+#include "../md/utils.h"
+
+#include <arpa/inet.h>
+#include <cstring>
+#include <iostream>
+#include <sstream>
+
+using namespace diag;
+
+namespace {
+const char *event_name(Event event) {
+  switch (event) {
+  case Event::SeqGap:
+    return "seq gap";
+  case Event::InvalidPacket:
+    return "invalid packet";
+  case Event::InflateFailed:
+    return "uncompress failure";
+  case Event::UnmatchedPacket:
+    return "unmatched packet";
+  default:
+    return "unknown";
+  }
+}
+} // namespace
+
+Logger &diag::logger() {
+  static Logger instance;
+  return instance;
+}
+
+Logger::Logger() : queue_(4096), window_start_(std::chrono::steady_clock::now()) {
+  for (auto &dropped : dropped_) {
+    dropped.store(0, std::memory_order_relaxed);
+  }
+  thread_ = std::thread(&Logger::run, this);
+}
+
+Logger::~Logger() { stop(); }
+
+void Logger::log(Event event, int64_t arg0, int64_t arg1, int64_t arg2,
+                 const u_char *dump, uint32_t dump_len) {
+  Record record;
+  record.event = event;
+  record.orig_len = dump_len;
+  record.dump_len =
+      dump_len < Record::MAX_DUMP_LEN ? dump_len : Record::MAX_DUMP_LEN;
+  record.args[0] = arg0;
+  record.args[1] = arg1;
+  record.args[2] = arg2;
+  if (dump != nullptr) {
+    std::memcpy(record.dump, dump, record.dump_len);
+  }
+  if (!queue_.push(record)) {
+    dropped_[static_cast<int>(event)].fetch_add(1, std::memory_order_relaxed);
+  }
+}
+
+void Logger::stop() {
+  if (!running_.exchange(false)) {
+    return;
+  }
+  thread_.join();
+
+  drain();
+  end_window();
+  for (int i = 0; i < static_cast<int>(Event::Count); i++) {
+    uint64_t dropped = dropped_[i].load(std::memory_order_relaxed);
+    if (total_[i] + dropped > 0) {
+      std::cerr << event_name(static_cast<Event>(i)) << ": " << total_[i] + dropped
+                << " in total\n";
+    }
+  }
+}
+
+void Logger::run() {
+  while (running_.load(std::memory_order_relaxed)) {
+    drain();
+    if (std::chrono::steady_clock::now() - window_start_ >=
+        std::chrono::seconds(1)) {
+      end_window();
+    }
+    std::this_thread::sleep_for(std::chrono::milliseconds(1));
+  }
+}
+
+void Logger::drain() {
+  Record record;
+  while (queue_.pop(record)) {
+    int idx = static_cast<int>(record.event);
+    total_[idx] += 1;
+    if (printed_[idx] < BURST) {
+      printed_[idx] += 1;
+      write(record);
+    } else {
+      suppressed_[idx] += 1;
+    }
+  }
+}
+
+void Logger::write(const Record &record) {
+  std::ostringstream ss;
+  switch (record.event) {
+  case Event::SeqGap:
+    ss << "channel " << record.args[0]
+       << " gets seq gap in packet with seq: " << record.args[1]
+       << ", current seq: " << record.args[2] << '\n';
+    break;
+  case Event::InvalidPacket:
+    ss << "find a udp packet does not match our protocol, source port: "
+       << record.args[0] << ", dest port: " << record.args[1]
+       << ", length: " << record.args[2] << '\n';
+    break;
+  case Event::InflateFailed:
+    ss << "uncompress failed with code " << record.args[0]
+       << ", skip this message\n";
+    break;
+  case Event::UnmatchedPacket: {
+    in_addr ip;
+    ip.s_addr = static_cast<in_addr_t>(record.args[1]);
+    ss << "udp packet " << record.args[0] << " from " << inet_ntoa(ip)
+       << " does not match any of the processor\n";
+    break;
+  }
+  default:
+    break;
+  }
+  if (record.dump_len > 0) {
+    md::print_hex_array(record.dump, record.dump_len, ss);
+    if (record.orig_len > record.dump_len) {
+      ss << "... (" << record.orig_len << " bytes)\n";
+    }
+  }
+  std::cerr << ss.str();
+}
+
+void Logger::end_window() {
+  for (int i = 0; i < static_cast<int>(Event::Count); i++) {
+    if (suppressed_[i] > 0) {
+      std::cerr << event_name(static_cast<Event>(i)) << ": " << suppressed_[i]
+                << " more suppressed\n";
+    }
+    printed_[i] = 0;
+    suppressed_[i] = 0;
+  }
+  window_start_ = std::chrono::steady_clock::now();
+}
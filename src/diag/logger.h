@@ -0,0 +1,84 @@
+#pragma once
+
+#include "mpsc_queue.h"
+
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <sys/types.h>
+#include <thread>
+
+namespace diag {
+enum class Event : uint16_t {
+  // args: channel id, packet seq, last seq
+  SeqGap,
+  // args: source port, dest port, udp length
+  InvalidPacket,
+  // args: zlib error code
+  InflateFailed,
+  // args: udp packet index, source ip (network order)
+  UnmatchedPacket,
+  Count,
+};
+
+// compact binary log record, formatted later by the background thread
+struct Record {
+  static const uint32_t MAX_DUMP_LEN = 64;
+
+  Event event;
+  uint16_t dump_len;
+  // full length of the dumped buffer, may exceed MAX_DUMP_LEN
+  uint32_t orig_len;
+  int64_t args[3];
+  u_char dump[MAX_DUMP_LEN];
+};
+
+// asynchronous diagnostics logger
+// hot path code only copies a Record into a lock-free queue, formatting and
+// writing to stderr happens on a background thread. every event type prints
+// at most BURST records per second, the rest are summarised with a count.
+class Logger {
+public:
+  static const uint32_t BURST = 10;
+
+  Logger();
+  ~Logger();
+
+  Logger(const Logger &) = delete;
+  Logger &operator=(const Logger &) = delete;
+
+  // never blocks, the record is dropped (but counted) if the queue is full
+  void log(Event event, int64_t arg0 = 0, int64_t arg1 = 0, int64_t arg2 = 0,
+           const u_char *dump = nullptr, uint32_t dump_len = 0);
+
+  // drain the queue, print summary and stop the background thread
+  void stop();
+
+private:
+  void run();
+  void drain();
+  void write(const Record &record);
+  void end_window();
+
+  MpscQueue<Record> queue_;
+  std::atomic<bool> running_{true};
+  std::thread thread_;
+
+  std::atomic<uint64_t> dropped_[static_cast<int>(Event::Count)];
+
+  // consumer side only
+  std::chrono::steady_clock::time_point window_start_;
+  uint64_t printed_[static_cast<int>(Event::Count)] = {};
+  uint64_t suppressed_[static_cast<int>(Event::Count)] = {};
+  uint64_t total_[static_cast<int>(Event::Count)] = {};
+};
+
+// process wide logger
+Logger &logger();
+
+inline void log(Event event, int64_t arg0 = 0, int64_t arg1 = 0,
+                int64_t arg2 = 0, const u_char *dump = nullptr,
+                uint32_t dump_len = 0) {
+  logger().log(event, arg0, arg1, arg2, dump, dump_len);
+}
+} // namespace diag
@@ -0,0 +1,68 @@
+#pragma once
+
+#include <atomic>
+#include <cstddef>
+#include <memory>
+
+namespace diag {
+// bounded lock-free queue, any number of producers and one consumer
+// each cell carries a sequence telling whether it is free or filled, so
+// producers only contend on the enqueue position (Vyukov's bounded queue)
+template <typename T> class MpscQueue {
+public:
+  // capacity shall be power of 2
+  explicit MpscQueue(size_t capacity)
+      : cells_(new Cell[capacity]), mask_(capacity - 1) {
+    for (size_t i = 0; i < capacity; i++) {
+      cells_[i].seq.store(i, std::memory_order_relaxed);
+    }
+  }
+
+  // returns false when the queue is full
+  bool push(const T &data) {
+    size_t pos = enqueue_pos_.load(std::memory_order_relaxed);
+    for (;;) {
+      Cell &cell = cells_[pos & mask_];
+      size_t seq = cell.seq.load(std::memory_order_acquire);
+      intptr_t diff = static_cast<intptr_t>(seq) - static_cast<intptr_t>(pos);
+      if (diff == 0) {
+        if (enqueue_pos_.compare_exchange_weak(pos, pos + 1,
+                                               std::memory_order_relaxed)) {
+          cell.data = data;
+          cell.seq.store(pos + 1, std::memory_order_release);
+          return true;
+        }
+      } else if (diff < 0) {
+        return false;
+      } else {
+        pos = enqueue_pos_.load(std::memory_order_relaxed);
+      }
+    }
+  }
+
+  // returns false when the queue is empty
+  bool pop(T &data) {
+    Cell &cell = cells_[dequeue_pos_ & mask_];
+    size_t seq = cell.seq.load(std::memory_order_acquire);
+    if (seq != dequeue_pos_ + 1) {
+      return false;
+    }
+    data = cell.data;
+    cell.seq.store(dequeue_pos_ + mask_ + 1, std::memory_order_release);
+    dequeue_pos_ += 1;
+    return true;
+  }
+
+private:
+  struct Cell {
+    std::atomic<size_t> seq;
+    T data;
+  };
+
+  std::unique_ptr<Cell[]> cells_;
+  const size_t mask_;
+  alignas(64) std::atomic<size_t> enqueue_pos_{0};
+  // only touched by the consumer
+  alignas(64) size_t dequeue_pos_{0};
+};
+} // namespace diag
@@ -0,0 +1,270 @@
+#include "gzip_frames.h"
+
+#include <algorithm>
+#include <cstring>
+#include <stdexcept>
+
+#include <zlib.h>
+
+using namespace io;
+
+namespace {
+// fixed gzip header with FEXTRA, then the "MF" subfield with the member size
+const size_t HEADER_SIZE = 10 + 2 + 4 + 4;
+const size_t TRAILER_SIZE = 8;
+const size_t SIZE_OFFSET = 16;
+
+void put32(char *p, uint32_t value) {
+  for (int i = 0; i < 4; ++i) {
+    p[i] = static_cast<char>(value >> (8 * i));
+  }
+}
+
+uint32_t get32(const unsigned char *p) {
+  return p[0] | p[1] << 8 | p[2] << 16 | static_cast<uint32_t>(p[3]) << 24;
+}
+
+// one gzip member of the whole input, raw deflate between our own header
+// and trailer, empty if zlib fails
+std::string compress_member(const std::string &input, int level) {
+  z_stream stream;
+  memset(&stream, 0, sizeof(stream));
+  if (deflateInit2(&stream, level, Z_DEFLATED, -15 /*raw*/, 8,
+                   Z_DEFAULT_STRATEGY) != Z_OK) {
+    return std::string();
+  }
+  std::string member(HEADER_SIZE + deflateBound(&stream, input.size()) +
+                         TRAILER_SIZE,
+                     '\0');
+  stream.next_in =
+      reinterpret_cast<Bytef *>(const_cast<char *>(input.data()));
+  stream.avail_in = input.size();
+  stream.next_out = reinterpret_cast<Bytef *>(&member[HEADER_SIZE]);
+  stream.avail_out = member.size() - HEADER_SIZE - TRAILER_SIZE;
+  int result = deflate(&stream, Z_FINISH);
+  size_t deflated = stream.total_out;
+  deflateEnd(&stream);
+  if (result != Z_STREAM_END) {
+    return std::string();
+  }
+  member.resize(HEADER_SIZE + deflated + TRAILER_SIZE);
+
+  // id, deflate, FEXTRA, no mtime, no extra flags, unix; XLEN 8
+  const char header[] = {'\x1f', '\x8b', 8, 4, 0, 0, 0, 0, 0, 3,
+                         8,      0,      'M', 'F', 4, 0};
+  memcpy(&member[0], header, sizeof(header));
+  put32(&member[SIZE_OFFSET], member.size());
+  uLong crc = crc32(0, reinterpret_cast<const Bytef *>(input.data()),
+                    input.size());
+  put32(&member[member.size() - 8], crc);
+  put32(&member[member.size() - 4], input.size());
+  return member;
+}
+} // namespace
+
+CompressionPool::CompressionPool(size_t threads, int level) : level_(level) {
+  if (threads == 0) {
+    throw std::invalid_argument("compression needs at least one thread");
+  }
+  for (size_t i = 0; i < threads; ++i) {
+    threads_.emplace_back(&CompressionPool::run, this);
+  }
+}
+
+CompressionPool::~CompressionPool() {
+  {
+    std::lock_guard<std::mutex> lock(mutex_);
+    stopping_ = true;
+  }
+  queued_.notify_all();
+  for (auto &thread : threads_) {
+    thread.join();
+  }
+}
+
+std::shared_ptr<CompressionPool::Job>
+CompressionPool::submit(std::string input) {
+  auto job = std::make_shared<Job>();
+  job->input = std::move(input);
+  {
+    std::lock_guard<std::mutex> lock(mutex_);
+    queue_.push_back(job);
+  }
+  queued_.notify_one();
+  return job;
+}
+
+void CompressionPool::wait(const Job &job) {
+  std::unique_lock<std::mutex> lock(mutex_);
+  finished_.wait(lock, [&job] { return job.done; });
+}
+
+bool CompressionPool::finished(const Job &job) {
+  std::lock_guard<std::mutex> lock(mutex_);
+  return job.done;
+}
+
+void CompressionPool::run() {
+  std::unique_lock<std::mutex> lock(mutex_);
+  while (true) {
+    queued_.wait(lock, [this] { return stopping_ || !queue_.empty(); });
+    // queued jobs are finished before stopping, their owners wait on them
+    if (queue_.empty()) {
+      return;
+    }
+    auto job = queue_.front();
+    queue_.pop_front();
+    lock.unlock();
+    std::string output = compress_member(job->input, level_);
+    lock.lock();
+    job->output = std::move(output);
+    job->input = std::string();
+    job->done = true;
+    finished_.notify_all();
+  }
+}
+
+GzipFrameBuffer::GzipFrameBuffer(const std::string &path, CompressionPool &pool,
+                                 size_t frame_size, size_t max_pending)
+    : pool_(pool), file_(fopen(path.c_str(), "wb")),
+      max_pending_(max_pending > 0 ? max_pending : 2 * pool.threads() + 2),
+      buffer_(frame_size) {
+  if (file_ == nullptr) {
+    throw std::runtime_error("cannot open " + path);
+  }
+  setp(buffer_.data(), buffer_.data() + buffer_.size());
+}
+
+bool GzipFrameBuffer::close() {
+  if (file_ == nullptr) {
+    return !failed_;
+  }
+  submit(true);
+  write_ready(true);
+  failed_ = fclose(file_) != 0 || failed_;
+  file_ = nullptr;
+  return !failed_;
+}
+
+GzipFrameBuffer::int_type GzipFrameBuffer::overflow(int_type ch) {
+  if (file_ == nullptr) {
+    return traits_type::eof();
+  }
+  submit(false);
+  if (!traits_type::eq_int_type(ch, traits_type::eof())) {
+    *pptr() = traits_type::to_char_type(ch);
+    pbump(1);
+  }
+  write_ready(false);
+  return traits_type::not_eof(ch);
+}
+
+int GzipFrameBuffer::sync() {
+  if (file_ == nullptr) {
+    return -1;
+  }
+  submit(true);
+  write_ready(true);
+  failed_ = fflush(file_) != 0 || failed_;
+  return failed_ ? -1 : 0;
+}
+
+void GzipFrameBuffer::submit(bool flush) {
+  char *begin = pbase();
+  char *end = pptr();
+  if (!flush) {
+    // frames end at a line end, a line longer than a frame is cut
+    char *line_end = end;
+    while (line_end != begin && line_end[-1] != '\n') {
+      --line_end;
+    }
+    if (line_end != begin) {
+      end = line_end;
+    } else {
+      end = pptr();
+    }
+  }
+  if (end != begin) {
+    pending_.push_back(pool_.submit(std::string(begin, end)));
+  }
+  // the partial line moves to the start of the next frame
+  size_t rest = pptr() - end;
+  std::memmove(buffer_.data(), end, rest);
+  setp(buffer_.data(), buffer_.data() + buffer_.size());
+  pbump(rest);
+}
+
+void GzipFrameBuffer::write_ready(bool wait_all) {
+  while (!pending_.empty()) {
+    const auto &job = *pending_.front();
+    if (wait_all || pending_.size() > max_pending_) {
+      pool_.wait(job);
+    } else if (!pool_.finished(job)) {
+      break;
+    }
+    failed_ = job.output.empty() ||
+              fwrite(job.output.data(), 1, job.output.size(), file_) !=
+                  job.output.size() ||
+              failed_;
+    pending_.pop_front();
+  }
+}
+
+std::vector<GzipFrame> io::list_frames(const std::string &path) {
+  std::vector<GzipFrame> frames;
+  FILE *file = fopen(path.c_str(), "rb");
+  if (file == nullptr) {
+    return frames;
+  }
+  uint64_t offset = 0;
+  unsigned char header[HEADER_SIZE];
+  while (fseek(file, offset, SEEK_SET) == 0 &&
+         fread(header, 1, sizeof(header), file) == sizeof(header)) {
+    if (header[0] != 0x1f || header[1] != 0x8b || header[3] != 4 ||
+        header[12] != 'M' || header[13] != 'F') {
+      break;
+    }
+    GzipFrame frame{offset, get32(header + SIZE_OFFSET), 0};
+    unsigned char size[4];
+    if (frame.size < HEADER_SIZE + TRAILER_SIZE ||
+        fseek(file, offset + frame.size - 4, SEEK_SET) != 0 ||
+        fread(size, 1, sizeof(size), file) != sizeof(size)) {
+      break;
+    }
+    frame.uncompressed = get32(size);
+    frames.push_back(frame);
+    offset += frame.size;
+  }
+  fclose(file);
+  return frames;
+}
+
+bool io::read_frame(const std::string &path, const GzipFrame &frame,
+                    std::string &text) {
+  FILE *file = fopen(path.c_str(), "rb");
+  if (file == nullptr) {
+    return false;
+  }
+  std::string member(frame.size, '\0');
+  bool ok = fseek(file, frame.offset, SEEK_SET) == 0 &&
+            fread(&member[0], 1, member.size(), file) == member.size();
+  fclose(file);
+  if (!ok) {
+    return false;
+  }
+
+  z_stream stream;
+  memset(&stream, 0, sizeof(stream));
+  if (inflateInit2(&stream, 16 + 15 /*gzip*/) != Z_OK) {
+    return false;
+  }
+  text.assign(frame.uncompressed, '\0');
+  stream.next_in = reinterpret_cast<Bytef *>(&member[0]);
+  stream.avail_in = member.size();
+  stream.next_out = reinterpret_cast<Bytef *>(&text[0]);
+  stream.avail_out = text.size();
+  // inflate checks the crc and size of the trailer
+  int result = inflate(&stream, Z_FINISH);
+  inflateEnd(&stream);
+  return result == Z_STREAM_END;
+}
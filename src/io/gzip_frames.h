@@ -0,0 +1,105 @@
+#pragma once
+
+#include <condition_variable>
+#include <cstdint>
+#include <cstdio>
+#include <deque>
+#include <memory>
+#include <mutex>
+#include <streambuf>
+#include <string>
+#include <thread>
+#include <vector>
+
+namespace io {
+// deflates frames on background threads, shared by all compressed outputs
+class CompressionPool {
+public:
+  struct Job {
+    std::string input;
+    // a complete gzip member once done
+    std::string output;
+    bool done{false};
+  };
+
+  // level as for gzip, 1 fastest to 9 smallest
+  explicit CompressionPool(size_t threads, int level = 6);
+  ~CompressionPool();
+
+  CompressionPool(const CompressionPool &) = delete;
+  CompressionPool &operator=(const CompressionPool &) = delete;
+
+  std::shared_ptr<Job> submit(std::string input);
+
+  // blocks until the job is compressed
+  void wait(const Job &job);
+
+  bool finished(const Job &job);
+
+  size_t threads() const { return threads_.size(); }
+
+private:
+  void run();
+
+  int level_;
+  std::mutex mutex_;
+  std::condition_variable queued_;
+  std::condition_variable finished_;
+  std::deque<std::shared_ptr<Job>> queue_;
+  bool stopping_{false};
+  std::vector<std::thread> threads_;
+};
+
+// output stream buffer writing a file of independent gzip members
+//
+// text is cut into frames of about frame_size bytes, each ending at a line
+// end, and every frame is compressed by the pool into its own member. the
+// file reads as one with gzip/zcat. a member starts with an "MF" extra
+// field holding its total size, so frames can be listed by hopping from
+// header to header and any frame can be decompressed on its own.
+// members are written in order by the producing thread, which only blocks
+// when max_pending frames are still being compressed
+class GzipFrameBuffer : public std::streambuf {
+public:
+  GzipFrameBuffer(const std::string &path, CompressionPool &pool,
+                  size_t frame_size = 1 << 20, size_t max_pending = 0);
+  ~GzipFrameBuffer() override { close(); }
+
+  // compress what is left, write all members and close the file
+  // returns false if any write failed
+  bool close();
+
+protected:
+  int_type overflow(int_type ch) override;
+  // ends the current frame and writes out all members
+  int sync() override;
+
+private:
+  // submit buffered text up to the last line end, all of it if flushing
+  void submit(bool flush);
+  // write out finished members in order, waiting for all if wait_all
+  void write_ready(bool wait_all);
+
+  CompressionPool &pool_;
+  FILE *file_;
+  size_t max_pending_;
+  bool failed_{false};
+  std::vector<char> buffer_;
+  std::deque<std::shared_ptr<CompressionPool::Job>> pending_;
+};
+
+struct GzipFrame {
+  uint64_t offset;
+  // of the member, compressed
+  uint32_t size;
+  uint32_t uncompressed;
+};
+
+// frames of a file written by GzipFrameBuffer, read from member headers and
+// trailers only, stops at the first member without the size field
+std::vector<GzipFrame> list_frames(const std::string &path);
+
+// text of one frame, false if it cannot be read or decompressed
+bool read_frame(const std::string &path, const GzipFrame &frame,
+                std::string &text);
+} // namespace io
@@ -0,0 +1,406 @@
+#include "uring_read_ahead.h"
+
+#include <algorithm>
+#include <chrono>
+#include <cstdlib>
+#include <cstring>
+#include <stdexcept>
+
+#include <fcntl.h>
+#include <linux/io_uring.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+
+using namespace io;
+
+namespace {
+const uint64_t DIRECT_ALIGNMENT = 4096;
+
+template <typename T> T load_acquire(const T *p) {
+  return __atomic_load_n(p, __ATOMIC_ACQUIRE);
+}
+
+template <typename T> void store_release(T *p, T v) {
+  __atomic_store_n(p, v, __ATOMIC_RELEASE);
+}
+} // namespace
+
+// minimal io_uring wrapper on raw syscalls, only what read-ahead needs
+class UringReadAhead::Ring {
+public:
+  explicit Ring(uint32_t entries) {
+    io_uring_params params;
+    std::memset(&params, 0, sizeof(params));
+    fd_ = syscall(__NR_io_uring_setup, entries, &params);
+    if (fd_ < 0) {
+      throw std::runtime_error("io_uring_setup failed");
+    }
+
+    sq_size_ = params.sq_off.array + params.sq_entries * sizeof(uint32_t);
+    cq_size_ = params.cq_off.cqes + params.cq_entries * sizeof(io_uring_cqe);
+    bool single_mmap = params.features & IORING_FEAT_SINGLE_MMAP;
+    if (single_mmap) {
+      sq_size_ = cq_size_ = std::max(sq_size_, cq_size_);
+    }
+
+    sq_ptr_ = mmap(nullptr, sq_size_, PROT_READ | PROT_WRITE,
+                   MAP_SHARED | MAP_POPULATE, fd_, IORING_OFF_SQ_RING);
+    cq_ptr_ = single_mmap ? sq_ptr_
+                          : mmap(nullptr, cq_size_, PROT_READ | PROT_WRITE,
+                                 MAP_SHARED | MAP_POPULATE, fd_,
+                                 IORING_OFF_CQ_RING);
+    sqes_size_ = params.sq_entries * sizeof(io_uring_sqe);
+    void *sqes = mmap(nullptr, sqes_size_, PROT_READ | PROT_WRITE,
+                      MAP_SHARED | MAP_POPULATE, fd_, IORING_OFF_SQES);
+    if (sq_ptr_ == MAP_FAILED || cq_ptr_ == MAP_FAILED || sqes == MAP_FAILED) {
+      close(fd_);
+      throw std::runtime_error("io_uring mmap failed");
+    }
+    sqes_ = static_cast<io_uring_sqe *>(sqes);
+
+    auto *sq = static_cast<u_char *>(sq_ptr_);
+    sq_tail_ = reinterpret_cast<uint32_t *>(sq + params.sq_off.tail);
+    sq_mask_ = *reinterpret_cast<uint32_t *>(sq + params.sq_off.ring_mask);
+    sq_array_ = reinterpret_cast<uint32_t *>(sq + params.sq_off.array);
+
+    auto *cq = static_cast<u_char *>(cq_ptr_);
+    cq_head_ = reinterpret_cast<uint32_t *>(cq + params.cq_off.head);
+    cq_tail_ = reinterpret_cast<uint32_t *>(cq + params.cq_off.tail);
+    cq_mask_ = *reinterpret_cast<uint32_t *>(cq + params.cq_off.ring_mask);
+    cqes_ = reinterpret_cast<io_uring_cqe *>(cq + params.cq_off.cqes);
+  }
+
+  ~Ring() {
+    munmap(sqes_, sqes_size_);
+    if (cq_ptr_ != sq_ptr_) {
+      munmap(cq_ptr_, cq_size_);
+    }
+    munmap(sq_ptr_, sq_size_);
+    close(fd_);
+  }
+
+  // callers never prepare more than the ring size before enter()
+  void prepare_read(int fd, void *buf, uint32_t len, uint64_t offset,
+                    uint64_t user_data) {
+    uint32_t tail = *sq_tail_;
+    uint32_t idx = tail & sq_mask_;
+    io_uring_sqe &sqe = sqes_[idx];
+    std::memset(&sqe, 0, sizeof(sqe));
+    sqe.opcode = IORING_OP_READ;
+    sqe.fd = fd;
+    sqe.addr = reinterpret_cast<uint64_t>(buf);
+    sqe.len = len;
+    sqe.off = offset;
+    sqe.user_data = user_data;
+    sq_array_[idx] = idx;
+    store_release(sq_tail_, tail + 1);
+    to_submit_ += 1;
+  }
+
+  // submit prepared reads and optionally wait for completions
+  void enter(uint32_t min_complete) {
+    if (to_submit_ == 0 && min_complete == 0) {
+      return;
+    }
+    unsigned flags = min_complete > 0 ? IORING_ENTER_GETEVENTS : 0;
+    int ret = syscall(__NR_io_uring_enter, fd_, to_submit_, min_complete,
+                      flags, nullptr, 0);
+    if (ret >= 0) {
+      to_submit_ -= ret < static_cast<int>(to_submit_) ? ret : to_submit_;
+    }
+  }
+
+  bool pop(uint64_t &user_data, int32_t &result) {
+    uint32_t head = *cq_head_;
+    if (head == load_acquire(cq_tail_)) {
+      return false;
+    }
+    const io_uring_cqe &cqe = cqes_[head & cq_mask_];
+    user_data = cqe.user_data;
+    result = cqe.res;
+    store_release(cq_head_, head + 1);
+    return true;
+  }
+
+private:
+  int fd_;
+  uint32_t to_submit_{0};
+
+  void *sq_ptr_;
+  void *cq_ptr_;
+  size_t sq_size_;
+  size_t cq_size_;
+  size_t sqes_size_;
+
+  io_uring_sqe *sqes_;
+  uint32_t *sq_tail_;
+  uint32_t sq_mask_;
+  uint32_t *sq_array_;
+
+  uint32_t *cq_head_;
+  uint32_t *cq_tail_;
+  uint32_t cq_mask_;
+  io_uring_cqe *cqes_;
+};
+
+UringReadAhead::UringReadAhead(std::vector<std::string> files,
+                               ReadAheadOptions options)
+    : options_(options) {
+  if (options_.queue_depth == 0) {
+    options_.queue_depth = 1;
+  }
+  if (options_.direct) {
+    // O_DIRECT needs block aligned offsets, lengths and buffers
+    options_.block_size = (options_.block_size + DIRECT_ALIGNMENT - 1) /
+                          DIRECT_ALIGNMENT * DIRECT_ALIGNMENT;
+  }
+
+  // checked up front but opened lazily, a day may have more files than
+  // the process may hold open
+  for (const auto &name : files) {
+    File file;
+    file.name = name;
+    struct stat st;
+    if (::stat(name.c_str(), &st) != 0 || access(name.c_str(), R_OK) != 0) {
+      throw std::invalid_argument("invalid pcap file: " + name);
+    }
+    file.size = st.st_size;
+    files_.push_back(file);
+  }
+
+  // the block being consumed plus queue_depth reads in flight, doubled so
+  // completed but unconsumed blocks do not starve the queue
+  blocks_.resize(options_.queue_depth * 2);
+  void *buffers = nullptr;
+  if (posix_memalign(&buffers, DIRECT_ALIGNMENT,
+                     blocks_.size() * options_.block_size) != 0) {
+    throw std::bad_alloc();
+  }
+  buffers_ = static_cast<u_char *>(buffers);
+
+  try {
+    ring_.reset(new Ring(options_.queue_depth));
+  } catch (const std::runtime_error &) {
+    // synchronous pread fallback
+    ring_.reset();
+  }
+}
+
+UringReadAhead::~UringReadAhead() {
+  // in-flight reads must land before their buffers go away
+  while (stats_.in_flight > 0 && ring_) {
+    ring_->enter(1);
+    uint64_t slot;
+    int32_t result;
+    while (ring_->pop(slot, result)) {
+      complete(slot, result);
+    }
+  }
+  ring_.reset();
+  free(buffers_);
+  for (auto &file : files_) {
+    close_file(file);
+  }
+}
+
+void UringReadAhead::open_file(File &file) {
+  file.direct = options_.direct;
+  file.fd = ::open(file.name.c_str(), O_RDONLY | (file.direct ? O_DIRECT : 0));
+  if (file.fd < 0 && file.direct) {
+    // e.g. tmpfs does not support O_DIRECT
+    file.direct = false;
+    file.fd = ::open(file.name.c_str(), O_RDONLY);
+  }
+  // a file which went away since is a read error to the consumer
+}
+
+void UringReadAhead::close_file(File &file) {
+  if (file.fd >= 0) {
+    ::close(file.fd);
+    file.fd = -1;
+  }
+  if (file.buffered_fd >= 0) {
+    ::close(file.buffered_fd);
+    file.buffered_fd = -1;
+  }
+}
+
+FILE *UringReadAhead::open_next() {
+  if (current_file_ + 1 >= static_cast<int>(files_.size())) {
+    return nullptr;
+  }
+  current_file_ += 1;
+
+  // drop what is left of previous files, e.g. processing stopped early
+  while (head_ < tail_ && blocks_[head_ % blocks_.size()].file_idx <
+                              static_cast<uint32_t>(current_file_)) {
+    wait_head();
+    head_ += 1;
+  }
+  if (submit_file_ < static_cast<uint32_t>(current_file_)) {
+    submit_file_ = current_file_;
+    submit_offset_ = 0;
+  }
+  for (int i = 0; i < current_file_; i++) {
+    close_file(files_[i]);
+  }
+  submit();
+
+  cookie_io_functions_t functions;
+  functions.read = &UringReadAhead::read_cookie;
+  functions.write = nullptr;
+  functions.seek = nullptr;
+  functions.close = &UringReadAhead::close_cookie;
+  return fopencookie(this, "r", functions);
+}
+
+ssize_t UringReadAhead::read_cookie(void *cookie, char *buf, size_t size) {
+  return static_cast<UringReadAhead *>(cookie)->read(buf, size);
+}
+
+int UringReadAhead::close_cookie(void *cookie) {
+  // blocks left in the queue are dropped by the next open_next()
+  return 0;
+}
+
+ssize_t UringReadAhead::read(char *buf, size_t size) {
+  size_t copied = 0;
+  while (copied < size) {
+    if (head_ == tail_) {
+      submit();
+      if (head_ == tail_) {
+        break;
+      }
+    }
+    Block &block = blocks_[head_ % blocks_.size()];
+    if (block.file_idx != static_cast<uint32_t>(current_file_)) {
+      // already prefetching the next file, i.e. end of this one
+      break;
+    }
+    wait_head();
+    if (block.length == 0) {
+      // read error
+      return copied > 0 ? copied : -1;
+    }
+
+    size_t n = std::min<size_t>(size - copied, block.length - block.consumed);
+    const u_char *src = buffers_ +
+                        (head_ % blocks_.size()) * options_.block_size +
+                        block.consumed;
+    std::memcpy(buf + copied, src, n);
+    block.consumed += n;
+    copied += n;
+    if (block.consumed == block.length) {
+      head_ += 1;
+      submit();
+    }
+  }
+  return copied;
+}
+
+void UringReadAhead::submit() {
+  bool prepared = false;
+  while (tail_ - head_ < blocks_.size() &&
+         stats_.in_flight < options_.queue_depth &&
+         submit_file_ < files_.size()) {
+    File &file = files_[submit_file_];
+    if (submit_offset_ >= file.size) {
+      submit_file_ += 1;
+      submit_offset_ = 0;
+      continue;
+    }
+    if (submit_offset_ == 0) {
+      open_file(file);
+    }
+
+    uint32_t slot = tail_ % blocks_.size();
+    Block &block = blocks_[slot];
+    block.file_idx = submit_file_;
+    block.offset = submit_offset_;
+    block.length = std::min<uint64_t>(options_.block_size,
+                                      file.size - submit_offset_);
+    block.done = false;
+    block.consumed = 0;
+    tail_ += 1;
+    submit_offset_ += options_.block_size;
+
+    stats_.reads_submitted += 1;
+    stats_.in_flight += 1;
+    stats_.bytes_in_flight += block.length;
+    stats_.max_in_flight = std::max(stats_.max_in_flight, stats_.in_flight);
+    stats_.max_bytes_in_flight =
+        std::max(stats_.max_bytes_in_flight, stats_.bytes_in_flight);
+
+    u_char *buf = buffers_ + slot * options_.block_size;
+    // O_DIRECT reads the whole aligned block, the tail comes back short
+    uint32_t length = file.direct ? options_.block_size : block.length;
+    if (ring_ && file.fd >= 0) {
+      ring_->prepare_read(file.fd, buf, length, block.offset, slot);
+      prepared = true;
+    } else {
+      complete(slot, pread(file.fd, buf, length, block.offset));
+    }
+  }
+  if (prepared) {
+    ring_->enter(0);
+  }
+}
+
+void UringReadAhead::complete(uint32_t slot, int32_t result) {
+  Block &block = blocks_[slot];
+  stats_.in_flight -= 1;
+  stats_.bytes_in_flight -= block.length;
+
+  uint32_t got = result > 0 ? result : 0;
+  if (got < block.length) {
+    // short read or error, e.g. network file systems, finish it synchronously
+    // without O_DIRECT, what is left is not block aligned
+    u_char *buf = buffers_ + slot * options_.block_size;
+    File &file = files_[block.file_idx];
+    int fd = file.fd;
+    if (file.direct) {
+      if (file.buffered_fd < 0) {
+        file.buffered_fd = ::open(file.name.c_str(), O_RDONLY);
+      }
+      fd = file.buffered_fd;
+    }
+    while (got < block.length) {
+      ssize_t n = pread(fd, buf + got, block.length - got, block.offset + got);
+      if (n <= 0) {
+        break;
+      }
+      got += n;
+    }
+    if (got < block.length) {
+      // reported as a read error to the consumer
+      block.length = 0;
+    }
+  }
+  stats_.bytes_read += block.length;
+  block.done = true;
+}
+
+void UringReadAhead::wait_head() {
+  Block &block = blocks_[head_ % blocks_.size()];
+  bool stalled = false;
+  auto start = std::chrono::steady_clock::now();
+  while (!block.done) {
+    uint64_t slot;
+    int32_t result;
+    while (ring_->pop(slot, result)) {
+      complete(slot, result);
+    }
+    if (!block.done) {
+      stalled = true;
+      ring_->enter(1);
+    }
+  }
+  if (stalled) {
+    stats_.stalls += 1;
+    stats_.stall_micros += std::chrono::duration_cast<std::chrono::microseconds>(
+                               std::chrono::steady_clock::now() - start)
+                               .count();
+  }
+}
@@ -0,0 +1,107 @@
+#pragma once
+
+#include <cstdint>
+#include <cstdio>
+#include <memory>
+#include <string>
+#include <sys/types.h>
+#include <vector>
+
+namespace io {
+struct ReadAheadOptions {
+  // max number of reads in flight
+  uint32_t queue_depth{8};
+  // size of every read, shall be a multiple of 4096 for O_DIRECT
+  uint32_t block_size{1 << 20};
+  // bypass page cache
+  bool direct{false};
+};
+
+struct ReadAheadStats {
+  uint64_t reads_submitted{0};
+  uint64_t bytes_read{0};
+  uint32_t in_flight{0};
+  uint32_t max_in_flight{0};
+  uint64_t bytes_in_flight{0};
+  uint64_t max_bytes_in_flight{0};
+  // times the consumer had to wait for a read to complete
+  uint64_t stalls{0};
+  uint64_t stall_micros{0};
+};
+
+// sequential read-ahead over a queue of files with io_uring
+//
+// reads of block_size are issued in file order into a recycled buffer pool,
+// keeping up to queue_depth of them in flight. when the current file has
+// been fully submitted the free buffers start prefetching the next one, so
+// switching files does not stall. a file is opened when its first read is
+// submitted and closed once the next one is opened as stream, so only the
+// files within reach of the queue are open. falls back to synchronous pread
+// if io_uring is not available.
+class UringReadAhead {
+public:
+  UringReadAhead(std::vector<std::string> files, ReadAheadOptions options);
+  ~UringReadAhead();
+
+  UringReadAhead(const UringReadAhead &) = delete;
+  UringReadAhead &operator=(const UringReadAhead &) = delete;
+
+  // stream over the next file in the queue, nullptr when all files are opened
+  // the stream shall be read sequentially and closed before opening the next
+  FILE *open_next();
+
+  const ReadAheadStats &stats() const { return stats_; }
+
+private:
+  struct File {
+    std::string name;
+    // opened when its first read is submitted, -1 before and after
+    int fd{-1};
+    bool direct{false};
+    // without O_DIRECT, for synchronous reads of any offset and length
+    int buffered_fd{-1};
+    uint64_t size{0};
+  };
+
+  struct Block {
+    uint32_t file_idx;
+    uint64_t offset;
+    uint32_t length;
+    bool done;
+    // bytes already handed to the consumer
+    uint32_t consumed;
+  };
+
+  class Ring;
+
+  static ssize_t read_cookie(void *cookie, char *buf, size_t size);
+  static int close_cookie(void *cookie);
+  ssize_t read(char *buf, size_t size);
+
+  void open_file(File &file);
+  void close_file(File &file);
+  void submit();
+  void complete(uint32_t slot, int32_t result);
+  void wait_head();
+
+  ReadAheadOptions options_;
+  std::vector<File> files_;
+  // file currently opened as stream, -1 before the first open_next()
+  int current_file_{-1};
+
+  std::unique_ptr<Ring> ring_;
+
+  // buffer pool, block i lives in buffer i
+  // blocks are used as a circular queue in submission order
+  std::vector<Block> blocks_;
+  u_char *buffers_{nullptr};
+  uint64_t head_{0};
+  uint64_t tail_{0};
+
+  // next block to submit
+  uint32_t submit_file_{0};
+  uint64_t submit_offset_{0};
+
+  ReadAheadStats stats_;
+};
+} // namespace io
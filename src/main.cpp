@@ -1,12 +1,26 @@
 #include "md/arbitrator.h"
+#include "md/bar.h"
+#include "md/channel_sharder.h"
+#include "md/conflator.h"
+#include "md/decoder.h"
+#include "md/fragment_merger.h"
 #include "md/preprocessor.h"
 #include "md/utils.h"
 #include "pcap/pcap_reader.h"
+#include "shm/broadcast_ring.h"
+#include "store/event_store.h"
 
 #include "csv/writer.h"
+#include "diag/logger.h"
+#include "io/uring_read_ahead.h"
 
 #include <iostream>
+#include <memory>
+#include <mutex>
 #include <set>
+#include <sstream>
+#include <vector>
+#include <unistd.h>
 
 std::set<uint32_t> get_interested_stocks(std::string file) {
   std::set<uint32_t> stock_ids;
@@ -19,17 +33,194 @@ std::set<uint32_t> get_interested_stocks(std::string file) {
   return stock_ids;
 }
 
-int main(int argc, char const *argv[]) {
-  if (argc != 4) {
-    std::cerr << "Usage: " << argv[0]
-              << " <pcap file> <stock filter> <output prefix>" << '\n';
+// comma separated list, e.g. "60,300"
+std::vector<std::string> split(const std::string &str) {
+  std::vector<std::string> items;
+  std::stringstream ss(str);
+  std::string item;
+  while (std::getline(ss, item, ',')) {
+    items.push_back(item);
+  }
+  return items;
+}
+
+std::vector<uint32_t> parse_uint_list(const std::string &str) {
+  std::vector<uint32_t> values;
+  for (const auto &item : split(str)) {
+    values.push_back(std::stoul(item));
+  }
+  return values;
+}
+
+void print_usage(const char *program) {
+  std::cerr << "Usage: " << program
+            << " [options] <pcap file>[,<pcap file>...] <stock filter> "
+               "<output prefix>\n"
+            << "  multiple pcap files are processed in order as one capture\n"
+            << "Options:\n"
+            << "  -b <seconds,...>  write OHLCV bars of the given widths,\n"
+            << "                    not with -t\n"
+            << "  -s <name>         publish all events to shared memory ring\n"
+            << "  -r <slots>        slots of the -s ring, 512 bytes each,\n"
+            << "                    default 65536 (32 MiB of /dev/shm)\n"
+            << "  -q <depth>        read pcap files with io_uring read-ahead\n"
+            << "  -D                use O_DIRECT for io_uring read-ahead,\n"
+            << "                    requires -q\n"
+            << "  -m <mode>         snapshot output: full, suppress or delta\n"
+            << "  -c <millis>       at most one snapshot per stock per interval\n"
+            << "                    of capture time\n"
+            << "  -k <seconds>      keyframe interval of suppress/delta mode\n"
+            << "  -p <messages>     skip channels without interested stocks,\n"
+            << "                    learned from the first messages, not\n"
+            << "                    with -b, -s or -S\n"
+            << "  -P <file>         channel map (channel_id,security_id lines)\n"
+            << "                    for -p, e.g. <prefix>_channels.csv\n"
+            << "  -x                also write index snapshot, security and\n"
+            << "                    market status and snapshot stats, which\n"
+            << "                    are otherwise counted as unhandled\n"
+            << "  -B <packets>      read packets in batches, e.g. 128\n"
+            << "  -t <workers>      decode on worker threads sharded by channel,\n"
+            << "                    rows keep the order within a channel only\n"
+            << "  -L <seconds>      write feed lead and capture latency\n"
+            << "                    histograms per interval of capture time\n"
+            << "  -d <rows>         write digests of all csv rows per channel,\n"
+            << "                    bars per width, every n rows, compare\n"
+            << "                    runs with digest_diff\n"
+            << "  -S <dir>          store all events per security in dir,\n"
+            << "                    query with store_query\n"
+            << "  -z <threads>      gzip csv outputs (.csv.gz) in frames\n"
+            << "                    compressed on background threads\n";
+}
+
+int main(int argc, char *argv[]) {
+  std::vector<uint32_t> bar_widths;
+  std::string shm_name;
+  uint32_t shm_slots = 1 << 16;
+  io::ReadAheadOptions read_ahead_options;
+  bool read_ahead = false;
+  md::ConflationOptions conflation_options;
+  uint32_t pruner_warmup = 0;
+  std::string channel_map_file;
+  bool write_schema_messages = false;
+  size_t packet_batch_size = 0;
+  size_t worker_count = 0;
+  md::FeedStatsOptions feed_stats_options;
+  bool feed_stats = false;
+  uint32_t digest_interval = 0;
+  std::string store_dir;
+  size_t compression_threads = 0;
+  int opt;
+  while ((opt = getopt(argc, argv, "b:s:r:q:Dm:c:k:p:P:xB:t:L:d:S:z:")) !=
+         -1) {
+    switch (opt) {
+    case 'b':
+      bar_widths = parse_uint_list(optarg);
+      break;
+    case 's':
+      shm_name = optarg;
+      break;
+    case 'r':
+      shm_slots = std::stoul(optarg);
+      if (shm_slots == 0 || shm_slots > (1u << 24)) {
+        std::cerr << "-r takes 1 to 16777216 slots\n";
+        return 1;
+      }
+      break;
+    case 'q':
+      read_ahead = true;
+      read_ahead_options.queue_depth = std::stoul(optarg);
+      break;
+    case 'D':
+      read_ahead_options.direct = true;
+      break;
+    case 'm':
+      if (std::string(optarg) == "full") {
+        conflation_options.mode = md::SnapshotMode::Full;
+      } else if (std::string(optarg) == "suppress") {
+        conflation_options.mode = md::SnapshotMode::Suppress;
+      } else if (std::string(optarg) == "delta") {
+        conflation_options.mode = md::SnapshotMode::Delta;
+      } else {
+        print_usage(argv[0]);
+        return 1;
+      }
+      break;
+    case 'c':
+      conflation_options.conflate_millis = std::stoll(optarg);
+      break;
+    case 'k':
+      conflation_options.keyframe_millis = std::stoll(optarg) * 1000;
+      break;
+    case 'p':
+      pruner_warmup = std::stoul(optarg);
+      break;
+    case 'P':
+      channel_map_file = optarg;
+      break;
+    case 'x':
+      write_schema_messages = true;
+      break;
+    case 'B':
+      packet_batch_size = std::stoul(optarg);
+      break;
+    case 't':
+      worker_count = std::stoul(optarg);
+      break;
+    case 'L':
+      feed_stats = true;
+      feed_stats_options.bucket_seconds = std::stoll(optarg);
+      if (feed_stats_options.bucket_seconds <= 0) {
+        std::cerr << "-L takes a positive number of seconds\n";
+        return 1;
+      }
+      break;
+    case 'd':
+      digest_interval = std::stoul(optarg);
+      break;
+    case 'S':
+      store_dir = optarg;
+      break;
+    case 'z':
+      compression_threads = std::stoul(optarg);
+      break;
+    default:
+      print_usage(argv[0]);
+      return 1;
+    }
+  }
+  if (argc - optind != 3) {
+    print_usage(argv[0]);
+    return 1;
+  }
+  // pruned channels are never decoded, outputs covering the full market
+  // would silently miss their securities
+  if ((pruner_warmup > 0 || !channel_map_file.empty()) &&
+      (!bar_widths.empty() || !shm_name.empty() || !store_dir.empty())) {
+    std::cerr << "-p/-P cannot be combined with -b, -s or -S, which cover "
+                 "all securities\n";
+    return 1;
+  }
+  // bars close on the first trade of a new bucket, workers running at their
+  // own pace would fold late trades into the next bar
+  if (!bar_widths.empty() && worker_count > 0) {
+    std::cerr << "-b cannot be combined with -t\n";
+    return 1;
+  }
+  if (read_ahead_options.direct && !read_ahead) {
+    std::cerr << "-D only applies to the read-ahead of -q\n";
     return 1;
   }
 
-  auto interested_stock_ids = get_interested_stocks(argv[2]);
-  std::string output_prefix = std::string(argv[3]);
+  auto pcap_files = split(argv[optind]);
+  auto interested_stock_ids = get_interested_stocks(argv[optind + 1]);
+  std::string output_prefix = std::string(argv[optind + 2]);
 
-  auto reader = PcapReader(argv[1]);
+  std::unique_ptr<io::UringReadAhead> uring;
+  if (read_ahead) {
+    uring.reset(new io::UringReadAhead(pcap_files, read_ahead_options));
+  }
+  // the reader of the file being processed
+  std::unique_ptr<PcapReader> reader;
 
   std::string order_header =
       R"(clockAtArrival,sequenceNo,exchId,securityType,__isRepeated,TransactTime,ChannelNo,ApplSeqNum,SecurityID,secid,mdSource,)"
@@ -41,81 +232,289 @@ int main(int argc, char const *argv[]) {
       R"(ms,clock,threadId,clockAtArrival,sequenceNo,source,StockID,exchange,time,cum_volume,cum_amount,close,__origTickSeq,)"
       R"(bid1p,bid2p,bid3p,bid4p,bid5p,bid1q,bid2q,bid3q,bid4q,bid5q,ask1p,ask2p,ask3p,ask4p,ask5p,ask1q,ask2q,ask3q,ask4q,ask5q,)"
       R"(openPrice,numTrades)";
+  if (conflation_options.mode == md::SnapshotMode::Delta) {
+    snapshot_header += ",keyframe";
+  }
 
-  csv::Writer order_writer(output_prefix + "_order.csv", order_header);
-  csv::Writer trade_writer(output_prefix + "_trade.csv", trade_header);
-  csv::Writer snapshot_writer(output_prefix + "_snapshot.csv", snapshot_header);
-  std::map<md::MessageType, int> unhandled_message_count;
+  // shared by all csv outputs, outlives them
+  std::unique_ptr<io::CompressionPool> compression;
+  if (compression_threads > 0) {
+    compression.reset(new io::CompressionPool(compression_threads));
+  }
+
+  csv::Writer order_writer(output_prefix + "_order.csv", order_header,
+                           compression.get());
+  csv::Writer trade_writer(output_prefix + "_trade.csv", trade_header,
+                           compression.get());
+  csv::Writer snapshot_writer(output_prefix + "_snapshot.csv", snapshot_header,
+                              compression.get());
+
+  // bars are built over the full market, not only interested stocks, so
+  // they cannot be combined with pruning
+  std::unique_ptr<csv::Writer> bar_writer;
+  std::unique_ptr<md::BarAggregator> bar_aggregator;
+  if (!bar_widths.empty()) {
+    std::string bar_header =
+        R"(SecurityID,barWidth,barTime,open,high,low,close,volume,turnover,vwap,numTrades)";
+    bar_writer.reset(new csv::Writer(output_prefix + "_bar.csv", bar_header,
+                                     compression.get()));
+    bar_aggregator.reset(new md::BarAggregator(
+        bar_widths, [&](const md::Bar &bar) { bar_writer->write_bar(bar); }));
+  }
 
-  md::MdArbitrator arbitrator;
-  auto md_handler = [&](const u_char *data, uint32_t data_len) {
-    md::PackedMarketData mds(data, data_len);
-    for (const md::MdHeader *header = mds.next_md(); header != nullptr;
-         header = mds.next_md()) {
-      const u_char *body =
-          reinterpret_cast<const u_char *>(header) + sizeof(md::MdHeader);
-      switch (header->message_type()) {
-      case md::MessageType::Order: {
-        const auto &order = *reinterpret_cast<const md::Order *>(body);
-        if (!arbitrator.record_order_or_trade(order.channel_no(),
-                                              order.appl_seq_num())) {
+  // the ring gets every arbitrated event, not only interested stocks, no
+  // channel is pruned with it
+  std::unique_ptr<shm::Publisher> publisher;
+  if (!shm_name.empty()) {
+    publisher.reset(new shm::Publisher(shm_name, shm_slots));
+  }
+
+  // like the ring, the store gets every arbitrated event
+  std::unique_ptr<store::Writer> event_store;
+  if (!store_dir.empty()) {
+    event_store.reset(new store::Writer(store_dir));
+  }
+
+  // messages beyond order, trade and snapshot, written as the schema says
+  std::unique_ptr<csv::Writer> index_writer;
+  std::unique_ptr<csv::Writer> security_status_writer;
+  std::unique_ptr<csv::Writer> market_status_writer;
+  std::unique_ptr<csv::Writer> snapshot_stats_writer;
+  if (write_schema_messages) {
+    namespace schema = md::schema;
+    index_writer.reset(new csv::Writer(
+        output_prefix + "_index.csv",
+        csv::Writer::message_header<schema::IndexSnapshot>(),
+        compression.get()));
+    security_status_writer.reset(new csv::Writer(
+        output_prefix + "_security_status.csv",
+        csv::Writer::message_header<schema::SecurityStatus>(),
+        compression.get()));
+    market_status_writer.reset(new csv::Writer(
+        output_prefix + "_market_status.csv",
+        csv::Writer::message_header<schema::MarketStatus>(),
+        compression.get()));
+    snapshot_stats_writer.reset(new csv::Writer(
+        output_prefix + "_snapshot_stats.csv",
+        csv::Writer::message_header<schema::SnapshotStats>(),
+        compression.get()));
+  }
+
+  // regression check of the csv outputs, see csv::Digest
+  std::ofstream digest_file;
+  // the writers run under their own locks, all digests share the file
+  std::mutex digest_mutex;
+  std::vector<std::unique_ptr<csv::Digest>> digests;
+  if (digest_interval > 0) {
+    digest_file.open(output_prefix + "_digest.csv");
+    digest_file << csv::Digest::header() << '\n';
+    auto digest = [&](csv::Writer *writer, const char *stream) {
+      if (writer != nullptr) {
+        digests.emplace_back(new csv::Digest(
+            stream, digest_interval, digest_file,
+            worker_count > 0 ? &digest_mutex : nullptr));
+        writer->set_digest(digests.back().get());
+      }
+    };
+    digest(&order_writer, "order");
+    digest(&trade_writer, "trade");
+    digest(&snapshot_writer, "snapshot");
+    digest(bar_writer.get(), "bar");
+    digest(index_writer.get(), "index");
+    digest(security_status_writer.get(), "security_status");
+    digest(market_status_writer.get(), "market_status");
+    digest(snapshot_stats_writer.get(), "snapshot_stats");
+  }
+
+  // only top 5 levels are written
+  conflation_options.depth = 5;
+
+  // one per decoding thread, channels and so securities are not shared
+  struct DecodeContext {
+    md::MdArbitrator arbitrator;
+    md::BatchDecoder decoder;
+    md::EventBatch batch;
+    // runs on the capture time of the thread's own packets
+    std::unique_ptr<md::SnapshotConflator> conflator;
+    std::map<md::MessageType, int> unhandled_message_count;
+    std::unique_ptr<md::FeedStats> feed_stats;
+  };
+  // outputs above are shared by decoding threads, each behind its own lock
+  // so workers only wait on one another for the same output. arbitration is
+  // per worker and runs unlocked
+  struct OutputLocks {
+    std::mutex order;
+    std::mutex trade;
+    std::mutex snapshot;
+    std::mutex publisher;
+    std::mutex store;
+    // the rare messages of -x
+    std::mutex schema;
+  } output_locks;
+  auto locked = [worker_count](std::mutex &mutex) {
+    return worker_count > 0 ? std::unique_lock<std::mutex>(mutex)
+                            : std::unique_lock<std::mutex>();
+  };
+  auto write_snapshot = [&](const md::SnapshotEvent &snapshot,
+                            const md::SnapshotEvent *previous,
+                            uint64_t pcap_ts, uint64_t pcap_seq) {
+    auto lock = locked(output_locks.snapshot);
+    if (conflation_options.mode == md::SnapshotMode::Delta) {
+      snapshot_writer.write_snapshot_delta(snapshot, previous, pcap_ts,
+                                           pcap_seq, conflation_options.depth);
+    } else {
+      snapshot_writer.write_snapshot(snapshot, pcap_ts, pcap_seq,
+                                     conflation_options.depth);
+    }
+  };
+  auto is_interested = [&](uint32_t stock_id) {
+    return interested_stock_ids.find(stock_id) != interested_stock_ids.end();
+  };
+  auto md_handler = [&](DecodeContext &context, uint32_t feed,
+                        const u_char *data, uint32_t data_len,
+                        const UdpPacket &packet) {
+    auto &arbitrator = context.arbitrator;
+    auto &batch = context.batch;
+    context.decoder.decode(data, data_len, batch);
+    uint64_t pcap_ts = packet.pcap_ts;
+    uint64_t pcap_seq = packet.index;
+    md::Arrival arrival{feed, pcap_ts};
+
+    // held snapshots of the thread's stocks are released as capture time
+    // passes
+    if (conflation_options.conflate_millis > 0) {
+      context.conflator->advance(pcap_ts, pcap_seq);
+    }
+
+    for (const auto &entry : batch.entries) {
+      switch (entry.type) {
+      case md::EventType::Order: {
+        const auto &order = batch.orders[entry.index];
+        if (!arbitrator.record_order_or_trade(
+                md::MessageType::Order, order.channel_no, order.appl_seq_num,
+                order.transaction_time, arrival)) {
           break;
         }
-        uint32_t stock_id = std::stoul(
-            md::bytes_to_str(order.security_id, sizeof(order.security_id)));
-        if (interested_stock_ids.find(stock_id) != interested_stock_ids.end()) {
-          order_writer.write_order(order,
-                                   get_pcap_timestamp(reader.pcap_header()),
-                                   reader.udp_packet_index());
+        if (publisher) {
+          auto lock = locked(output_locks.publisher);
+          publisher->publish(order, pcap_ts, pcap_seq);
+        }
+        if (event_store) {
+          auto lock = locked(output_locks.store);
+          event_store->append(order, pcap_ts, pcap_seq);
+        }
+        if (is_interested(order.security_id)) {
+          auto lock = locked(output_locks.order);
+          order_writer.write_order(order, pcap_ts, pcap_seq);
         }
-
         break;
       }
-      case md::MessageType::Trade: {
-        const auto &trade = *reinterpret_cast<const md::Trade *>(body);
-
-        if (!arbitrator.record_order_or_trade(trade.channel_no(),
-                                              trade.appl_seq_num())) {
+      case md::EventType::Trade: {
+        const auto &trade = batch.trades[entry.index];
+        if (!arbitrator.record_order_or_trade(
+                md::MessageType::Trade, trade.channel_no, trade.appl_seq_num,
+                trade.transaction_time, arrival)) {
           break;
         }
-        uint32_t stock_id = std::stoul(
-            md::bytes_to_str(trade.security_id, sizeof(trade.security_id)));
-        if (interested_stock_ids.find(stock_id) != interested_stock_ids.end()) {
-          trade_writer.write_trade(trade,
-                                   get_pcap_timestamp(reader.pcap_header()),
-                                   reader.udp_packet_index());
+        if (publisher) {
+          auto lock = locked(output_locks.publisher);
+          publisher->publish(trade, pcap_ts, pcap_seq);
+        }
+        if (event_store) {
+          auto lock = locked(output_locks.store);
+          event_store->append(trade, pcap_ts, pcap_seq);
+        }
+        // 'F' is a fill, '4' is a cancel which carries no price
+        // bars are not built with workers, see -b
+        if (bar_aggregator && trade.execute_type == 'F') {
+          bar_aggregator->on_trade(trade.security_id, trade.price,
+                                   trade.quantity, trade.transaction_time);
+        }
+        if (is_interested(trade.security_id)) {
+          auto lock = locked(output_locks.trade);
+          trade_writer.write_trade(trade, pcap_ts, pcap_seq);
         }
-
         break;
       }
-      case md::MessageType::Snapshot: {
-        md::SnapshotWrapper snapshot_wrapper(body); // max 10 levels
-        if (!arbitrator.record_snapshot(snapshot_wrapper.security_id,
-                                        snapshot_wrapper.orig_time)) {
+      case md::EventType::Snapshot: {
+        const auto &snapshot = batch.snapshots[entry.index];
+        if (!arbitrator.record_snapshot(snapshot.channel_no,
+                                        snapshot.security_id,
+                                        snapshot.orig_time, arrival)) {
           break;
         }
-        uint32_t stock_id = std::stoul(snapshot_wrapper.security_id);
-        if (interested_stock_ids.find(stock_id) != interested_stock_ids.end()) {
-          // only write top 5 levels
-          snapshot_wrapper.init_md_entries();
-          int depth = 5;
-          snapshot_writer.write_snapshot(
-              snapshot_wrapper, get_pcap_timestamp(reader.pcap_header()),
-              reader.udp_packet_index(), depth);
+        if (publisher) {
+          auto lock = locked(output_locks.publisher);
+          publisher->publish(snapshot, pcap_ts, pcap_seq);
+        }
+        if (event_store) {
+          auto lock = locked(output_locks.store);
+          event_store->append(snapshot, pcap_ts, pcap_seq);
+        }
+        if (is_interested(snapshot.security_id)) {
+          context.conflator->on_snapshot(snapshot, pcap_ts, pcap_seq);
         }
         break;
       }
-
-      case md::MessageType::SnapshotStats:
-      case md::MessageType::Heartbeat: {
-        // ignored
+      case md::EventType::IndexSnapshot: {
+        const auto &index = batch.index_snapshots[entry.index];
+        if (index_writer &&
+            arbitrator.record_message(
+                md::MessageType::IndexSnapshot,
+                md::parse_security_id(index.head.security_id.data),
+                index.head.orig_time, arrival)) {
+          auto lock = locked(output_locks.schema);
+          index_writer->write_message(index, index.head.channel_no,
+                                      index.head.orig_time, pcap_ts,
+                                      pcap_seq);
+        }
         break;
       }
-
-      default:
-        // unhandled message
-        unhandled_message_count[header->message_type()] += 1;
+      case md::EventType::SecurityStatus: {
+        const auto &status = batch.security_statuses[entry.index];
+        if (security_status_writer &&
+            arbitrator.record_message(
+                md::MessageType::SecurityStatus,
+                md::parse_security_id(status.head.security_id.data),
+                status.head.orig_time, arrival)) {
+          auto lock = locked(output_locks.schema);
+          security_status_writer->write_message(
+              status, status.head.channel_no, status.head.orig_time, pcap_ts,
+              pcap_seq);
+        }
+        break;
+      }
+      case md::EventType::MarketStatus: {
+        const auto &status = batch.market_statuses[entry.index];
+        if (market_status_writer &&
+            arbitrator.record_message(md::MessageType::MarketStatus,
+                                      status.channel_no, status.orig_time,
+                                      arrival)) {
+          auto lock = locked(output_locks.schema);
+          market_status_writer->write_message(status, status.channel_no,
+                                              status.orig_time, pcap_ts,
+                                              pcap_seq);
+        }
+        break;
+      }
+      case md::EventType::SnapshotStats: {
+        const auto &stats = batch.snapshot_stats[entry.index];
+        if (snapshot_stats_writer &&
+            arbitrator.record_message(md::MessageType::SnapshotStats,
+                                      stats.head.channel_no,
+                                      stats.head.orig_time, arrival)) {
+          auto lock = locked(output_locks.schema);
+          snapshot_stats_writer->write_message(stats, stats.head.channel_no,
+                                               stats.head.orig_time, pcap_ts,
+                                               pcap_seq);
+        }
+        break;
       }
+      }
+    }
+
+    for (auto type : batch.unhandled) {
+      context.unhandled_message_count[type] += 1;
     }
   };
 
@@ -123,20 +522,190 @@ int main(int argc, char const *argv[]) {
   // arbitrate between two feeds
   std::string net1("172.27.1");
   std::string net2("172.27.129");
-  if (reader.set_filter("net " + net1 + " or net " + net2) != 0) {
-    std::cerr << "set filter failed" << '\n';
-    return 2;
-  }
   std::string netmask("255.255.255.0");
-  md::MdPreprocessor processor1(net1 + ".0", netmask, md_handler);
-  md::MdPreprocessor processor2(net2 + ".0", netmask, md_handler);
-  reader.add_processor(&processor1);
-  reader.add_processor(&processor2);
 
-  // 1587627830 is 2020-04-23 15:43:50, from given output log,
-  uint64_t udp_packet_count = reader.process(1587627830);
+  // channel map for pruning, channels missing from it are still learned
+  std::vector<std::pair<uint32_t, uint32_t>> channel_map;
+  std::ifstream channel_map_stream(channel_map_file);
+  std::string line;
+  while (std::getline(channel_map_stream, line)) {
+    auto fields = parse_uint_list(line);
+    if (fields.size() == 2) {
+      channel_map.emplace_back(fields[0], fields[1]);
+    }
+  }
+  bool pruning = pruner_warmup > 0 || !channel_map_file.empty();
+  uint32_t warmup = pruner_warmup > 0 ? pruner_warmup : 1000;
+
+  // one pipeline on the capture thread, or one per worker thread
+  struct Pipeline {
+    DecodeContext context;
+    std::unique_ptr<md::ChannelPruner> pruner;
+    md::FragmentMerger merger;
+    std::unique_ptr<md::MdPreprocessor> processor1;
+    std::unique_ptr<md::MdPreprocessor> processor2;
+  };
+  std::vector<std::unique_ptr<Pipeline>> pipelines;
+  for (size_t i = 0; i < std::max<size_t>(worker_count, 1); ++i) {
+    std::unique_ptr<Pipeline> pipeline(new Pipeline);
+    auto *context = &pipeline->context;
+    context->decoder.set_schema_messages(write_schema_messages);
+    context->conflator.reset(
+        new md::SnapshotConflator(conflation_options, write_snapshot));
+    if (feed_stats) {
+      context->feed_stats.reset(new md::FeedStats(feed_stats_options));
+      context->arbitrator.set_stats(context->feed_stats.get());
+    }
+    // feeds are numbered in the order of the nets
+    auto handler = [&md_handler, context](uint32_t feed) {
+      return [&md_handler, context, feed](const u_char *data,
+                                          uint32_t data_len,
+                                          const UdpPacket &packet) {
+        md_handler(*context, feed, data, data_len, packet);
+      };
+    };
+    pipeline->processor1.reset(
+        new md::MdPreprocessor(net1 + ".0", netmask, handler(0)));
+    pipeline->processor2.reset(
+        new md::MdPreprocessor(net2 + ".0", netmask, handler(1)));
+    // multi-packet messages are reassembled from both feeds, once
+    pipeline->processor1->set_merger(&pipeline->merger, 0);
+    pipeline->processor2->set_merger(&pipeline->merger, 1);
+    if (pruning) {
+      pipeline->pruner.reset(
+          new md::ChannelPruner(interested_stock_ids, warmup));
+      for (const auto &kv : channel_map) {
+        pipeline->pruner->configure(kv.first, kv.second);
+      }
+      pipeline->processor1->set_pruner(pipeline->pruner.get());
+      pipeline->processor2->set_pruner(pipeline->pruner.get());
+    }
+    pipelines.push_back(std::move(pipeline));
+  }
+
+  UdpPacketProcessor *feed1 = pipelines[0]->processor1.get();
+  UdpPacketProcessor *feed2 = pipelines[0]->processor2.get();
+  std::unique_ptr<md::ChannelSharder> sharder;
+  if (worker_count > 0) {
+    std::vector<std::vector<UdpPacketProcessor *>> processors;
+    for (const auto &pipeline : pipelines) {
+      processors.push_back(
+          {pipeline->processor1.get(), pipeline->processor2.get()});
+    }
+    sharder.reset(new md::ChannelSharder(processors));
+    feed1 = sharder->feed(0, net1 + ".0", netmask);
+    feed2 = sharder->feed(1, net2 + ".0", netmask);
+  }
+
+  uint64_t udp_packet_count = 0;
+  // sequenceNo keeps counting across the files of one capture
+  uint64_t udp_packet_index = 0;
+  for (const auto &pcap_file : pcap_files) {
+    if (uring) {
+      reader.reset(new PcapReader(uring->open_next(), pcap_file));
+    } else {
+      reader.reset(new PcapReader(pcap_file));
+    }
+    reader->set_udp_packet_index(udp_packet_index);
+    // the reader matches the feed nets itself, no bpf filter needed
+    reader->add_processor(feed1);
+    reader->add_processor(feed2);
+
+    // 1587627830 is 2020-04-23 15:43:50, from given output log,
+    if (packet_batch_size > 0) {
+      udp_packet_count +=
+          reader->process_batched(packet_batch_size, 1587627830);
+    } else {
+      udp_packet_count += reader->process(1587627830);
+    }
+    udp_packet_index = reader->udp_packet_index();
+  }
+  if (sharder) {
+    sharder->stop();
+  }
+  if (bar_aggregator) {
+    bar_aggregator->flush();
+  }
+  for (const auto &pipeline : pipelines) {
+    pipeline->context.conflator->flush();
+  }
+  for (auto &digest : digests) {
+    digest->flush();
+  }
+  diag::logger().stop();
 
   std::cout << udp_packet_count << " udp packets processed" << '\n';
+  if (bar_aggregator && bar_aggregator->late_trades() > 0) {
+    std::cout << "bars: " << bar_aggregator->late_trades()
+              << " late trades dropped\n";
+  }
+  if (event_store) {
+    if (!event_store->flush()) {
+      std::cerr << "writing store " << store_dir << " failed\n";
+    }
+    const auto &stats = event_store->stats();
+    std::cout << "store: " << stats.records << " events (" << stats.bytes
+              << " bytes) in " << stats.segments << " segments\n";
+  }
+  if (pruning) {
+    // workers learn disjoint channels, but each is given the whole -P map
+    md::ChannelPruner::Stats pruned;
+    std::set<std::pair<uint32_t, uint32_t>> channels;
+    for (const auto &pipeline : pipelines) {
+      pruned.messages += pipeline->pruner->stats().messages;
+      pruned.bytes += pipeline->pruner->stats().bytes;
+      pipeline->pruner->collect(channels);
+    }
+    std::ofstream channel_file(output_prefix + "_channels.csv");
+    md::ChannelPruner::dump(channels, channel_file);
+    std::cout << pruned.messages << " messages (" << pruned.bytes
+              << " bytes) pruned\n";
+  }
+  md::FragmentMerger::Stats fragments;
+  for (const auto &pipeline : pipelines) {
+    const auto &stats = pipeline->merger.stats();
+    fragments.fragments += stats.fragments;
+    fragments.merged += stats.merged;
+    fragments.completed += stats.completed;
+    fragments.duplicates += stats.duplicates;
+    fragments.evicted += stats.evicted;
+  }
+  std::cout << "fragments: " << fragments.fragments << ", "
+            << fragments.completed << " messages completed, "
+            << fragments.merged << " joined across feeds, "
+            << fragments.duplicates << " late duplicates, "
+            << fragments.evicted << " partial messages evicted\n";
+  if (sharder) {
+    std::cout << "packets per worker:";
+    for (auto count : sharder->packets()) {
+      std::cout << ' ' << count;
+    }
+    std::cout << ", " << sharder->full_waits() << " waits on full queues\n";
+  }
+  if (uring) {
+    const auto &stats = uring->stats();
+    std::cout << "read-ahead: " << stats.bytes_read << " bytes in "
+              << stats.reads_submitted << " reads, max in flight "
+              << stats.max_in_flight << " reads / "
+              << stats.max_bytes_in_flight << " bytes, " << stats.stalls
+              << " stalls (" << stats.stall_micros << " us)\n";
+  }
+  if (feed_stats) {
+    md::FeedStats merged(feed_stats_options);
+    for (const auto &pipeline : pipelines) {
+      merged.merge(*pipeline->context.feed_stats);
+    }
+    std::ofstream leads(output_prefix + "_feed_lead.csv");
+    merged.write_leads(leads);
+    std::ofstream latencies(output_prefix + "_latency.csv");
+    merged.write_latencies(latencies);
+  }
+  std::map<md::MessageType, int> unhandled_message_count;
+  for (const auto &pipeline : pipelines) {
+    for (const auto &kv : pipeline->context.unhandled_message_count) {
+      unhandled_message_count[kv.first] += kv.second;
+    }
+  }
   for (const auto &kv : unhandled_message_count) {
     std::cerr << "unhandled message type: " << static_cast<uint32_t>(kv.first)
               << ", count: " << kv.second << '\n';
@@ -1,7 +1,11 @@
 #pragma once
 
 // map is faster for small data set
+#include "common.h"
+#include "feed_stats.h"
+
 #include <cassert>
+#include <cstdint>
 #include <map>
 #include <unordered_map>
 
@@ -19,7 +23,7 @@ public:
   }
 
   // for snapshot
-  bool record_snapshot(const std::string &stock, int64_t exchange_time) {
+  bool record_snapshot(uint32_t stock, int64_t exchange_time) {
     if (exchange_time_recorder_[stock] >= exchange_time) {
       return false;
     }
@@ -27,7 +31,57 @@ public:
     return true;
   }
 
+  // for other messages carrying an exchange time, e.g. index snapshot
+  // id is security id or channel no, depending on the message type
+  bool record_message(MessageType type, uint32_t id, int64_t exchange_time) {
+    uint64_t key = static_cast<uint64_t>(type) << 32 | id;
+    if (message_time_recorder_[key] >= exchange_time) {
+      return false;
+    }
+    message_time_recorder_[key] = exchange_time;
+    return true;
+  }
+
+  // not owned, the overloads below report to it when set
+  void set_stats(FeedStats *stats) { stats_ = stats; }
+
+  bool record_order_or_trade(MessageType type, uint16_t channel_id,
+                             uint64_t appl_seq_num, int64_t transaction_time,
+                             const Arrival &arrival) {
+    bool won = record_order_or_trade(channel_id, appl_seq_num);
+    if (stats_ != nullptr) {
+      stats_->on_sequenced(channel_id, appl_seq_num, won, arrival);
+      if (won) {
+        stats_->on_latency(type, transaction_time, arrival);
+      }
+    }
+    return won;
+  }
+
+  bool record_snapshot(uint16_t channel_id, uint32_t stock,
+                       int64_t exchange_time, const Arrival &arrival) {
+    bool won = record_snapshot(stock, exchange_time);
+    if (stats_ != nullptr) {
+      stats_->on_snapshot(channel_id, stock, exchange_time, won, arrival);
+      if (won) {
+        stats_->on_latency(MessageType::Snapshot, exchange_time, arrival);
+      }
+    }
+    return won;
+  }
+
+  bool record_message(MessageType type, uint32_t id, int64_t exchange_time,
+                      const Arrival &arrival) {
+    bool won = record_message(type, id, exchange_time);
+    if (stats_ != nullptr && won) {
+      stats_->on_latency(type, exchange_time, arrival);
+    }
+    return won;
+  }
+
 private:
+  FeedStats *stats_{nullptr};
+
   // key: channel id, value: last seen appl_seq_num
   // appl_seq_num shall be unique for each channel
   // Assumption: we shall not receive out-of-order appl_seq_num
@@ -37,6 +91,9 @@ private:
   // key: stock id, value: exchange timestamp
   // stock id shall be unique in each snapshot
   // Assumption: exchange time shall be the same for all stocks in a snapshot
-  std::unordered_map<std::string, int64_t> exchange_time_recorder_;
+  std::unordered_map<uint32_t, int64_t> exchange_time_recorder_;
+
+  // key: message type << 32 | id, value: exchange timestamp
+  std::unordered_map<uint64_t, int64_t> message_time_recorder_;
 };
 } // namespace md
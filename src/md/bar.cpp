@@ -0,0 +1,106 @@
+#include "bar.h"
+#include "utils.h"
+
+#include <algorithm>
+#include <stdexcept>
+
+using namespace md;
+
+BarAggregator::BarAggregator(std::vector<uint32_t> widths_in_seconds,
+                             BarHandler handler)
+    : bar_handler_(handler) {
+  for (uint32_t width : widths_in_seconds) {
+    if (width == 0) {
+      throw std::invalid_argument("bar width must be positive");
+    }
+    Series series;
+    series.width_seconds = width;
+    series.width_millis = width * 1000LL;
+    series_.push_back(std::move(series));
+  }
+}
+
+uint32_t BarAggregator::slot_of(uint32_t security_id) {
+  auto it = slots_.find(security_id);
+  if (it != slots_.end()) {
+    return it->second;
+  }
+
+  uint32_t slot = security_ids_.size();
+  slots_.emplace(security_id, slot);
+  security_ids_.push_back(security_id);
+  for (auto &series : series_) {
+    series.bucket.push_back(-1);
+    series.open.push_back(0);
+    series.high.push_back(0);
+    series.low.push_back(0);
+    series.close.push_back(0);
+    series.volume.push_back(0);
+    series.turnover.push_back(0);
+    series.trade_count.push_back(0);
+  }
+  return slot;
+}
+
+void BarAggregator::on_trade(uint32_t security_id, int64_t price,
+                             int64_t quantity, int64_t transaction_time) {
+  uint32_t slot = slot_of(security_id);
+  int64_t millis = exchange_time_to_millis(transaction_time);
+
+  for (auto &series : series_) {
+    int64_t bucket = millis / series.width_millis;
+    if (bucket < series.bucket[slot]) {
+      // its bar is gone, folding it into the open one would misplace it
+      late_trades_ += 1;
+      continue;
+    }
+    if (bucket > series.bucket[slot]) {
+      // the security moved into a new bucket, its open bar is complete
+      close_bar(series, slot);
+      series.bucket[slot] = bucket;
+    }
+
+    if (series.trade_count[slot] == 0) {
+      series.open[slot] = price;
+      series.high[slot] = price;
+      series.low[slot] = price;
+    } else {
+      series.high[slot] = std::max(series.high[slot], price);
+      series.low[slot] = std::min(series.low[slot], price);
+    }
+    series.close[slot] = price;
+    series.volume[slot] += quantity;
+    series.turnover[slot] += price * quantity / 100;
+    series.trade_count[slot] += 1;
+  }
+}
+
+void BarAggregator::close_bar(Series &series, uint32_t slot) {
+  if (series.trade_count[slot] == 0) {
+    return;
+  }
+  Bar bar;
+  bar.security_id = security_ids_[slot];
+  bar.width_seconds = series.width_seconds;
+  bar.start_millis = series.bucket[slot] * series.width_millis;
+  bar.open = series.open[slot];
+  bar.high = series.high[slot];
+  bar.low = series.low[slot];
+  bar.close = series.close[slot];
+  bar.volume = series.volume[slot];
+  bar.turnover = series.turnover[slot];
+  bar.trade_count = series.trade_count[slot];
+  bar_handler_(bar);
+
+  series.volume[slot] = 0;
+  series.turnover[slot] = 0;
+  series.trade_count[slot] = 0;
+}
+
+void BarAggregator::flush() {
+  for (auto &series : series_) {
+    for (uint32_t slot = 0; slot < security_ids_.size(); slot++) {
+      close_bar(series, slot);
+    }
+  }
+}
@@ -0,0 +1,77 @@
+#pragma once
+
+#include <cstdint>
+#include <functional>
+#include <unordered_map>
+#include <vector>
+
+namespace md {
+// one closed time bar of a security
+// prices keep the wire scale of md::Trade::price()
+struct Bar {
+  uint32_t security_id;
+  uint32_t width_seconds;
+  // bar start, milliseconds since midnight
+  int64_t start_millis;
+  int64_t open;
+  int64_t high;
+  int64_t low;
+  int64_t close;
+  int64_t volume;
+  // price * volume / 100, same as TradeMoney in trade csv
+  int64_t turnover;
+  uint32_t trade_count;
+
+  double vwap() const { return volume == 0 ? 0 : 100.0 * turnover / volume; }
+};
+
+// streaming OHLCV aggregation over trades for several bar widths at once
+// state is kept as structure-of-arrays indexed by security slot, and a bar is
+// emitted to the handler as soon as a trade of its security falls past its
+// end. each security keeps its own clock, channels lag behind each other
+// and a trade of one must not close the bars of another
+class BarAggregator {
+public:
+  using BarHandler = std::function<void(const Bar &)>;
+
+  BarAggregator(std::vector<uint32_t> widths_in_seconds, BarHandler handler);
+
+  // transaction_time is the raw exchange time (YYYYMMDDHHMMSSsss)
+  void on_trade(uint32_t security_id, int64_t price, int64_t quantity,
+                int64_t transaction_time);
+
+  // emit all bars still open, e.g. at the end of a capture
+  void flush();
+
+  // trades older than the open bar of their security, dropped, counted
+  // once per width they were late for
+  uint64_t late_trades() const { return late_trades_; }
+
+private:
+  struct Series {
+    uint32_t width_seconds;
+    int64_t width_millis;
+
+    // bucket of the open bar, -1 means nothing seen yet
+    std::vector<int64_t> bucket;
+    std::vector<int64_t> open;
+    std::vector<int64_t> high;
+    std::vector<int64_t> low;
+    std::vector<int64_t> close;
+    std::vector<int64_t> volume;
+    std::vector<int64_t> turnover;
+    std::vector<uint32_t> trade_count;
+  };
+
+  uint32_t slot_of(uint32_t security_id);
+  void close_bar(Series &series, uint32_t slot);
+
+  BarHandler bar_handler_;
+  std::vector<Series> series_;
+
+  // key: security id, value: slot in every series
+  std::unordered_map<uint32_t, uint32_t> slots_;
+  std::vector<uint32_t> security_ids_;
+  uint64_t late_trades_{0};
+};
+} // namespace md
@@ -0,0 +1,105 @@
+#include "channel_pruner.h"
+#include "common.h"
+#include "order.h"
+#include "snapshot.h"
+#include "trade.h"
+#include "utils.h"
+
+using namespace md;
+
+void ChannelPruner::add_security(Channel &channel, uint32_t security_id) {
+  channel.securities.insert(security_id);
+  if (interested_stock_ids_.find(security_id) != interested_stock_ids_.end()) {
+    channel.mode = Mode::Interested;
+  }
+}
+
+void ChannelPruner::configure(uint32_t channel_id, uint32_t security_id) {
+  Channel &channel = channels_[channel_id];
+  if (channel.mode == Mode::Learning) {
+    channel.mode = Mode::Pruned;
+  }
+  add_security(channel, security_id);
+}
+
+bool ChannelPruner::wants(uint32_t channel_id, bool single_packet) {
+  Channel &channel = channels_[channel_id];
+  if (channel.mode != Mode::Pruned) {
+    return true;
+  }
+  // only single packet messages are probed, a probe never leaves a partial
+  // message behind
+  if (!single_packet) {
+    return false;
+  }
+  channel.since_probe += 1;
+  if (channel.since_probe < probe_interval_) {
+    return false;
+  }
+  channel.since_probe = 0;
+  channel.probing = true;
+  return true;
+}
+
+bool ChannelPruner::learning(uint32_t channel_id) const {
+  auto it = channels_.find(channel_id);
+  return it == channels_.end() || it->second.mode == Mode::Learning ||
+         it->second.probing;
+}
+
+void ChannelPruner::learn(uint32_t channel_id, const u_char *data,
+                          uint32_t len) {
+  Channel &channel = channels_[channel_id];
+  channel.probing = false;
+
+  PackedMarketData mds(data, len);
+  for (const MdHeader *header = mds.next_md(); header != nullptr;
+       header = mds.next_md()) {
+    const u_char *body =
+        reinterpret_cast<const u_char *>(header) + sizeof(MdHeader);
+    switch (header->message_type()) {
+    case MessageType::Order:
+      add_security(channel,
+                   parse_security_id(
+                       reinterpret_cast<const Order *>(body)->security_id));
+      break;
+    case MessageType::Trade:
+      add_security(channel,
+                   parse_security_id(
+                       reinterpret_cast<const Trade *>(body)->security_id));
+      break;
+    case MessageType::Snapshot:
+      add_security(
+          channel,
+          parse_security_id(
+              reinterpret_cast<const SnapshotHeader *>(body)->security_id));
+      break;
+    default:
+      break;
+    }
+  }
+
+  if (channel.mode == Mode::Learning) {
+    channel.learned_messages += 1;
+    if (channel.learned_messages >= warmup_messages_) {
+      channel.mode = Mode::Pruned;
+    }
+  }
+}
+
+void ChannelPruner::collect(
+    std::set<std::pair<uint32_t, uint32_t>> &channels) const {
+  for (const auto &kv : channels_) {
+    for (uint32_t security_id : kv.second.securities) {
+      channels.emplace(kv.first, security_id);
+    }
+  }
+}
+
+void ChannelPruner::dump(
+    const std::set<std::pair<uint32_t, uint32_t>> &channels,
+    std::ostream &os) {
+  for (const auto &channel : channels) {
+    os << channel.first << ',' << channel.second << '\n';
+  }
+}
@@ -0,0 +1,82 @@
+#pragma once
+
+#include <cstdint>
+#include <iostream>
+#include <map>
+#include <set>
+#include <sys/types.h>
+#include <utility>
+
+namespace md {
+// decides per channel whether messages are worth reassembling and inflating
+//
+// each channel carries a stable subset of securities. a channel is learned
+// by scanning its first messages for interested securities, or configured
+// from a channel -> security map. channels without any interested security
+// are pruned, except that every probe_interval-th single packet message is
+// still inflated, so a security showing up later flips the channel back.
+//
+// the same pruner is shared by both feeds, channel ids are the same.
+class ChannelPruner {
+public:
+  struct Stats {
+    uint64_t messages{0};
+    uint64_t bytes{0};
+  };
+
+  ChannelPruner(std::set<uint32_t> interested_stock_ids,
+                uint32_t warmup_messages, uint32_t probe_interval = 1000)
+      : interested_stock_ids_(interested_stock_ids),
+        warmup_messages_(warmup_messages), probe_interval_(probe_interval) {}
+
+  // known channel content, e.g. from a previous run
+  void configure(uint32_t channel_id, uint32_t security_id);
+
+  // whether the next packet of the channel shall be processed
+  bool wants(uint32_t channel_id, bool single_packet);
+
+  // shall learn() see the message which is about to be handled
+  bool learning(uint32_t channel_id) const;
+
+  // scan an inflated message for securities
+  void learn(uint32_t channel_id, const u_char *data, uint32_t len);
+
+  void count_pruned(uint32_t bytes, bool new_message) {
+    stats_.bytes += bytes;
+    stats_.messages += new_message ? 1 : 0;
+  }
+
+  const Stats &stats() const { return stats_; }
+
+  // channel_id, security_id pairs known, learned or configured
+  void collect(std::set<std::pair<uint32_t, uint32_t>> &channels) const;
+
+  // "channel_id,security_id" lines, can be loaded by configure()
+  static void dump(const std::set<std::pair<uint32_t, uint32_t>> &channels,
+                   std::ostream &os);
+
+private:
+  enum class Mode {
+    Learning,
+    Interested,
+    Pruned,
+  };
+
+  struct Channel {
+    Mode mode{Mode::Learning};
+    uint32_t learned_messages{0};
+    uint32_t since_probe{0};
+    bool probing{false};
+    std::set<uint32_t> securities;
+  };
+
+  void add_security(Channel &channel, uint32_t security_id);
+
+  std::set<uint32_t> interested_stock_ids_;
+  uint32_t warmup_messages_;
+  uint32_t probe_interval_;
+
+  std::map<uint32_t, Channel> channels_;
+  Stats stats_;
+};
+} // namespace md
@@ -0,0 +1,85 @@
+#include "channel_sharder.h"
+#include "preprocessor.h"
+
+#include <sched.h>
+#include <stdexcept>
+
+using namespace md;
+
+ChannelSharder::ChannelSharder(
+    std::vector<std::vector<UdpPacketProcessor *>> processors,
+    size_t queue_capacity) {
+  if (processors.empty()) {
+    throw std::invalid_argument("channel sharder needs a worker");
+  }
+  for (auto &worker_processors : processors) {
+    std::unique_ptr<Worker> worker(new Worker(queue_capacity));
+    worker->processors = worker_processors;
+    workers_.push_back(std::move(worker));
+  }
+  for (auto &worker : workers_) {
+    Worker *w = worker.get();
+    worker->thread = std::thread([this, w] { run(*w); });
+  }
+}
+
+UdpPacketProcessor *ChannelSharder::feed(size_t feed, std::string net,
+                                         std::string netmask) {
+  routers_.emplace_back(new Router(this, feed, net, netmask));
+  return routers_.back().get();
+}
+
+void ChannelSharder::route(uint32_t feed, const UdpPacket &packet) {
+  // malformed packets go to any worker, the preprocessor reports them
+  uint32_t channel_id =
+      packet.captured >= sizeof(UdpPayload)
+          ? reinterpret_cast<const UdpPayload *>(packet.payload)->channel_id()
+          : 0;
+
+  auto found = channel_workers_.find(channel_id);
+  if (found == channel_workers_.end()) {
+    Worker *worker = workers_[next_worker_++ % workers_.size()].get();
+    found = channel_workers_.emplace(channel_id, worker).first;
+  }
+
+  Worker &worker = *found->second;
+  worker.packets += 1;
+  while (!worker.queue.push(packet, feed)) {
+    full_waits_ += 1;
+    sched_yield();
+  }
+}
+
+void ChannelSharder::run(Worker &worker) {
+  for (;;) {
+    // read before the queue, so nothing pushed before stop() is missed
+    bool stopping = stopping_.load(std::memory_order_acquire);
+    const PacketQueue::Slot *slot = worker.queue.front();
+    if (slot == nullptr) {
+      if (stopping) {
+        return;
+      }
+      sched_yield();
+      continue;
+    }
+    worker.processors[slot->tag]->process(slot->packet);
+    worker.queue.pop();
+  }
+}
+
+void ChannelSharder::stop() {
+  stopping_.store(true, std::memory_order_release);
+  for (auto &worker : workers_) {
+    if (worker->thread.joinable()) {
+      worker->thread.join();
+    }
+  }
+}
+
+std::vector<uint64_t> ChannelSharder::packets() const {
+  std::vector<uint64_t> counts;
+  for (const auto &worker : workers_) {
+    counts.push_back(worker->packets);
+  }
+  return counts;
+}
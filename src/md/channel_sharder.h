@@ -0,0 +1,80 @@
+#pragma once
+
+#include "../pcap/packet_queue.h"
+
+#include <atomic>
+#include <memory>
+#include <string>
+#include <thread>
+#include <unordered_map>
+#include <vector>
+
+namespace md {
+// runs md processors on worker threads, sharded by channel
+//
+// the capture thread only peeks at the channel id of a packet and copies it
+// to the queue of the channel's worker. a channel is pinned to the worker it
+// is first assigned to, round robin, so packets of a channel from all feeds
+// are processed in capture order. state keyed by channel or security behind
+// the processors, e.g. reassembly, pruning and arbitration, needs no locking
+// as long as each worker has its own.
+class ChannelSharder {
+public:
+  // processors[worker][feed], only called on the worker thread
+  explicit ChannelSharder(
+      std::vector<std::vector<UdpPacketProcessor *>> processors,
+      size_t queue_capacity = 2048);
+
+  ~ChannelSharder() { stop(); }
+
+  // capture side processor of processors[*][feed], owned by the sharder
+  UdpPacketProcessor *feed(size_t feed, std::string net,
+                           std::string netmask);
+
+  // wait until queued packets are processed and join the workers
+  void stop();
+
+  // packets handed to each worker
+  std::vector<uint64_t> packets() const;
+
+  // times the capture thread found a queue full
+  uint64_t full_waits() const { return full_waits_; }
+
+private:
+  class Router : public UdpPacketProcessor {
+  public:
+    Router(ChannelSharder *sharder, uint32_t feed, std::string net,
+           std::string netmask)
+        : UdpPacketProcessor(net, netmask), sharder_(sharder), feed_(feed) {}
+
+    void process(const UdpPacket &packet) override {
+      sharder_->route(feed_, packet);
+    }
+
+  private:
+    ChannelSharder *sharder_;
+    uint32_t feed_;
+  };
+
+  struct Worker {
+    explicit Worker(size_t queue_capacity) : queue(queue_capacity) {}
+
+    PacketQueue queue;
+    std::vector<UdpPacketProcessor *> processors;
+    uint64_t packets{0};
+    std::thread thread;
+  };
+
+  void route(uint32_t feed, const UdpPacket &packet);
+  void run(Worker &worker);
+
+  std::vector<std::unique_ptr<Worker>> workers_;
+  std::vector<std::unique_ptr<Router>> routers_;
+  std::atomic<bool> stopping_{false};
+
+  // capture thread only
+  std::unordered_map<uint32_t, Worker *> channel_workers_;
+  size_t next_worker_{0};
+  uint64_t full_waits_{0};
+};
+} // namespace md
@@ -5,10 +5,14 @@
 #include <iostream>
 
 namespace md {
+// every type here shall have a layout in schema.h
 enum class MessageType : uint32_t {
   Snapshot = 300111,
   Trade = 300191,
   Order = 300192,
+  IndexSnapshot = 309011,
+  SecurityStatus = 390013,
+  MarketStatus = 390019,
   Heartbeat = 390095,
   SnapshotStats = 390090,
 };
@@ -0,0 +1,112 @@
+#include "conflator.h"
+#include "utils.h"
+
+#include <algorithm>
+#include <limits>
+
+using namespace md;
+
+bool SnapshotConflator::same_book(const SnapshotEvent &a,
+                                  const SnapshotEvent &b) const {
+  if (a.total_trade_num != b.total_trade_num ||
+      a.total_trade_volume != b.total_trade_volume ||
+      a.total_trade_value != b.total_trade_value ||
+      a.latest_trade_price != b.latest_trade_price ||
+      a.open_price != b.open_price) {
+    return false;
+  }
+  for (int i = 0; i < options_.depth && i < SnapshotEvent::DEPTH; i++) {
+    if (a.bids[i].price != b.bids[i].price ||
+        a.bids[i].quantity != b.bids[i].quantity ||
+        a.asks[i].price != b.asks[i].price ||
+        a.asks[i].quantity != b.asks[i].quantity) {
+      return false;
+    }
+  }
+  return true;
+}
+
+void SnapshotConflator::on_snapshot(const SnapshotEvent &snapshot,
+                                    uint64_t pcap_ts, uint64_t pcap_seq) {
+  advance(pcap_ts, pcap_seq);
+  State &state = states_[snapshot.security_id];
+  // pcap_ts is in microseconds
+  uint64_t release_pcap_ts =
+      state.last_pcap_ts +
+      static_cast<uint64_t>(options_.conflate_millis) * 1000;
+
+  if (state.emitted && options_.conflate_millis > 0 &&
+      pcap_ts < release_pcap_ts) {
+    if (state.pending) {
+      dropped_ += 1;
+    } else {
+      state.pending = true;
+      state.release_pcap_ts = release_pcap_ts;
+      releases_.push(Release{state.release_pcap_ts, snapshot.security_id});
+    }
+    state.held = snapshot;
+    return;
+  }
+  if (state.pending) {
+    // superseded by this one
+    state.pending = false;
+    dropped_ += 1;
+  }
+  emit(state, snapshot, pcap_ts, pcap_seq);
+}
+
+void SnapshotConflator::emit(State &state, const SnapshotEvent &snapshot,
+                             uint64_t pcap_ts, uint64_t pcap_seq) {
+  int64_t millis = exchange_time_to_millis(snapshot.orig_time);
+  bool keyframe = !state.emitted ||
+                  millis - state.keyframe_millis >= options_.keyframe_millis;
+
+  if (options_.mode == SnapshotMode::Suppress && !keyframe &&
+      same_book(snapshot, state.last)) {
+    dropped_ += 1;
+    return;
+  }
+
+  const SnapshotEvent *previous = nullptr;
+  if (options_.mode == SnapshotMode::Delta && !keyframe) {
+    previous = &state.last;
+  }
+  snapshot_handler_(snapshot, previous, pcap_ts, pcap_seq);
+  emitted_ += 1;
+
+  state.emitted = true;
+  state.last = snapshot;
+  state.last_pcap_ts = pcap_ts;
+  if (keyframe) {
+    state.keyframe_millis = millis;
+  }
+}
+
+void SnapshotConflator::advance(uint64_t pcap_ts, uint64_t pcap_seq) {
+  if (pcap_ts >= last_pcap_ts_) {
+    last_pcap_ts_ = pcap_ts;
+    last_pcap_seq_ = pcap_seq;
+  }
+  release(pcap_ts, pcap_ts, pcap_seq);
+}
+
+void SnapshotConflator::flush() {
+  // the end of the capture cuts the intervals short
+  release(std::numeric_limits<uint64_t>::max(), last_pcap_ts_,
+          last_pcap_seq_);
+}
+
+void SnapshotConflator::release(uint64_t until, uint64_t pcap_ts,
+                                uint64_t pcap_seq) {
+  while (!releases_.empty() && releases_.top().pcap_ts <= until) {
+    Release release = releases_.top();
+    releases_.pop();
+    State &state = states_[release.security_id];
+    if (state.pending && state.release_pcap_ts == release.pcap_ts) {
+      state.pending = false;
+      // due when its interval ended, not with whichever packet came next,
+      // so a worker seeing only its channels decides as a single thread
+      emit(state, state.held, std::min(release.pcap_ts, pcap_ts), pcap_seq);
+    }
+  }
+}
@@ -0,0 +1,108 @@
+#pragma once
+
+#include "event.h"
+
+#include <functional>
+#include <queue>
+#include <unordered_map>
+#include <vector>
+
+namespace md {
+enum class SnapshotMode {
+  // every snapshot
+  Full,
+  // unchanged snapshots are dropped
+  Suppress,
+  // only changed fields, relative to the last snapshot emitted
+  Delta,
+};
+
+struct ConflationOptions {
+  SnapshotMode mode{SnapshotMode::Full};
+  // at most one snapshot per security per interval of capture time, 0 to
+  // disable
+  int64_t conflate_millis{0};
+  // a full snapshot is emitted at least this often per security, in
+  // exchange time
+  int64_t keyframe_millis{60000};
+  // only top levels take part in change detection
+  int depth{5};
+};
+
+// decides which snapshots get written, keeping the last emitted book per
+// security. keyframes follow exchange time (orig_time) as the book does.
+//
+// conflation runs on capture time alone, the clock that releases held
+// snapshots: a snapshot arriving within the interval after the last one
+// written is held back and replaced by newer ones, so the latest state is
+// still emitted once the interval has passed, checked on every advance() or
+// snapshot. it is written at the capture time the interval ended, with the
+// sequence of the packet releasing it, so rows stay in capture order.
+class SnapshotConflator {
+public:
+  // previous is the last emitted snapshot of the security in delta mode,
+  // nullptr if the snapshot shall be written in full
+  using SnapshotHandler =
+      std::function<void(const SnapshotEvent &snapshot,
+                         const SnapshotEvent *previous, uint64_t pcap_ts,
+                         uint64_t pcap_seq)>;
+
+  SnapshotConflator(ConflationOptions options, SnapshotHandler handler)
+      : options_(options), snapshot_handler_(handler) {}
+
+  void on_snapshot(const SnapshotEvent &snapshot, uint64_t pcap_ts,
+                   uint64_t pcap_seq);
+
+  // emit held snapshots whose interval has passed by this packet, call for
+  // every packet, including those without snapshots
+  void advance(uint64_t pcap_ts, uint64_t pcap_seq);
+
+  // emit all held snapshots at the last packet seen, at the end of a run
+  void flush();
+
+  uint64_t emitted() const { return emitted_; }
+  uint64_t dropped() const { return dropped_; }
+
+private:
+  struct State {
+    bool emitted{false};
+    SnapshotEvent last;
+    // capture time of the last snapshot written
+    uint64_t last_pcap_ts{0};
+    int64_t keyframe_millis{0};
+
+    bool pending{false};
+    SnapshotEvent held;
+    // capture time the held snapshot is released at
+    uint64_t release_pcap_ts{0};
+  };
+
+  struct Release {
+    uint64_t pcap_ts;
+    uint32_t security_id;
+    bool operator>(const Release &other) const {
+      return pcap_ts > other.pcap_ts;
+    }
+  };
+
+  void emit(State &state, const SnapshotEvent &snapshot, uint64_t pcap_ts,
+            uint64_t pcap_seq);
+  bool same_book(const SnapshotEvent &a, const SnapshotEvent &b) const;
+  // emit held snapshots released up to until, with the sequence of the
+  // given packet and the release time, cut to its capture time
+  void release(uint64_t until, uint64_t pcap_ts, uint64_t pcap_seq);
+
+  ConflationOptions options_;
+  SnapshotHandler snapshot_handler_;
+
+  // key: security id
+  std::unordered_map<uint32_t, State> states_;
+  // held snapshots, earliest release first, superseded ones are skipped
+  std::priority_queue<Release, std::vector<Release>, std::greater<Release>>
+      releases_;
+  uint64_t last_pcap_ts_{0};
+  uint64_t last_pcap_seq_{0};
+  uint64_t emitted_{0};
+  uint64_t dropped_{0};
+};
+} // namespace md
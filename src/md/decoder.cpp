@@ -0,0 +1,218 @@
+#include "decoder.h"
+#include "utils.h"
+
+#include <cstddef>
+#include <cstring>
+
+#ifdef __SSSE3__
+#include <tmmintrin.h>
+#endif
+
+using namespace md;
+
+// the hot types keep hand-written wire structs for the shuffles below, they
+// shall agree with the schema
+static_assert(sizeof(Order) == sizeof(schema::Order::Wire), "order layout");
+static_assert(offsetof(Order, be_price) + sizeof(int64_t) ==
+                  offsetof(Order, be_quantity),
+              "order price/quantity shall be adjacent");
+static_assert(sizeof(Trade) == sizeof(schema::Trade::Wire), "trade layout");
+static_assert(offsetof(Trade, be_bid_appl_seq_num) + sizeof(uint64_t) ==
+                  offsetof(Trade, be_offer_appl_seq_num),
+              "trade bid/offer seq num shall be adjacent");
+static_assert(sizeof(SnapshotHeader) == sizeof(schema::SnapshotHead::Wire),
+              "snapshot layout");
+static_assert(sizeof(MarketDataEntry) == sizeof(schema::SnapshotEntry::Wire),
+              "snapshot entry layout");
+static_assert(offsetof(SnapshotHeader, be_total_trade_num) + sizeof(int64_t) ==
+                  offsetof(SnapshotHeader, be_total_trade_volume),
+              "snapshot trade num/volume shall be adjacent");
+static_assert(offsetof(MarketDataEntry, be_md_entry_price) + sizeof(int64_t) ==
+                  offsetof(MarketDataEntry, be_md_entry_size),
+              "snapshot entry price/size shall be adjacent");
+
+// be64x2toh() stores 16 bytes at once, so the event fields it writes shall
+// be adjacent too
+static_assert(offsetof(OrderEvent, price) + sizeof(int64_t) ==
+                  offsetof(OrderEvent, quantity),
+              "order event price/quantity shall be adjacent");
+static_assert(offsetof(TradeEvent, bid_appl_seq_num) + sizeof(uint64_t) ==
+                  offsetof(TradeEvent, offer_appl_seq_num),
+              "trade event bid/offer seq num shall be adjacent");
+static_assert(offsetof(TradeEvent, price) + sizeof(int64_t) ==
+                  offsetof(TradeEvent, quantity),
+              "trade event price/quantity shall be adjacent");
+static_assert(offsetof(SnapshotEvent, total_trade_num) + sizeof(int64_t) ==
+                  offsetof(SnapshotEvent, total_trade_volume),
+              "snapshot event trade num/volume shall be adjacent");
+static_assert(offsetof(BookLevel, price) + sizeof(int64_t) ==
+                      offsetof(BookLevel, quantity) &&
+                  sizeof(BookLevel) == 2 * sizeof(int64_t),
+              "book level shall be price then quantity");
+
+namespace {
+// byte swap two adjacent big-endian 64 bit fields, dst needs not be aligned
+inline void be64x2toh(const void *src, void *dst) {
+#ifdef __SSSE3__
+  const __m128i mask =
+      _mm_set_epi8(8, 9, 10, 11, 12, 13, 14, 15, 0, 1, 2, 3, 4, 5, 6, 7);
+  __m128i v = _mm_loadu_si128(reinterpret_cast<const __m128i *>(src));
+  _mm_storeu_si128(reinterpret_cast<__m128i *>(dst), _mm_shuffle_epi8(v, mask));
+#else
+  uint64_t v[2];
+  std::memcpy(v, src, sizeof(v));
+  v[0] = be64toh(v[0]);
+  v[1] = be64toh(v[1]);
+  std::memcpy(dst, v, sizeof(v));
+#endif
+}
+
+void decode_order(const Order &wire, OrderEvent &event) {
+  event.appl_seq_num = wire.appl_seq_num();
+  // price, quantity
+  be64x2toh(&wire.be_price, &event.price);
+  event.transaction_time = wire.transaction_time();
+  event.security_id = parse_security_id(wire.security_id);
+  event.channel_no = wire.channel_no();
+  event.side = wire.side;
+  event.order_type = wire.order_type;
+}
+
+void decode_trade(const Trade &wire, TradeEvent &event) {
+  event.appl_seq_num = wire.appl_seq_num();
+  // bid_appl_seq_num, offer_appl_seq_num
+  be64x2toh(&wire.be_bid_appl_seq_num, &event.bid_appl_seq_num);
+  // price, quantity
+  be64x2toh(&wire.be_price, &event.price);
+  event.transaction_time = wire.transaction_time();
+  event.security_id = parse_security_id(wire.security_id);
+  event.channel_no = wire.channel_no();
+  event.execute_type = wire.execute_type;
+}
+
+// entries beyond size are ignored
+void decode_snapshot(const SnapshotHeader &wire, uint32_t size,
+                     SnapshotEvent &event) {
+  event = SnapshotEvent();
+  event.orig_time = wire.orig_time();
+  // total_trade_num, total_trade_volume
+  be64x2toh(&wire.be_total_trade_num, &event.total_trade_num);
+  event.total_trade_value = wire.total_trade_value();
+  event.security_id = parse_security_id(wire.security_id);
+  event.channel_no = wire.channel_no();
+
+  const u_char *entries =
+      reinterpret_cast<const u_char *>(&wire) + sizeof(SnapshotHeader);
+  const u_char *end = reinterpret_cast<const u_char *>(&wire) + size;
+  for (uint32_t i = 0; i < wire.md_entry_num() &&
+                       entries + sizeof(MarketDataEntry) <= end;
+       i++) {
+    const auto &entry = *reinterpret_cast<const MarketDataEntry *>(entries);
+    uint16_t level = entry.price_level();
+    switch (entry.md_entry_type()) {
+    case MdEntryType::Open:
+      event.open_price = entry.price();
+      break;
+
+    case MdEntryType::Latest:
+      event.latest_trade_price = entry.price();
+      break;
+
+    case MdEntryType::Buy:
+      if (level >= 1 && level <= SnapshotEvent::DEPTH) {
+        // price, quantity
+        be64x2toh(&entry.be_md_entry_price, &event.bids[level - 1]);
+      }
+      break;
+
+    case MdEntryType::Sell:
+      if (level >= 1 && level <= SnapshotEvent::DEPTH) {
+        be64x2toh(&entry.be_md_entry_price, &event.asks[level - 1]);
+      }
+      break;
+
+    default:
+      // ignored
+      break;
+    }
+    // ignore per-order quantity information
+    entries += sizeof(MarketDataEntry) +
+               entry.number_of_quantity_awared_orders() * sizeof(int64_t);
+  }
+}
+} // namespace
+
+void BatchDecoder::on(MessageTag<MessageType::Order>, const u_char *body,
+                      uint32_t size) {
+  if (size < sizeof(Order)) {
+    batch_->unhandled.push_back(MessageType::Order);
+    return;
+  }
+  batch_->entries.push_back(
+      {EventType::Order, static_cast<uint32_t>(wire_orders_.size())});
+  wire_orders_.push_back(reinterpret_cast<const Order *>(body));
+}
+
+void BatchDecoder::on(MessageTag<MessageType::Trade>, const u_char *body,
+                      uint32_t size) {
+  if (size < sizeof(Trade)) {
+    batch_->unhandled.push_back(MessageType::Trade);
+    return;
+  }
+  batch_->entries.push_back(
+      {EventType::Trade, static_cast<uint32_t>(wire_trades_.size())});
+  wire_trades_.push_back(reinterpret_cast<const Trade *>(body));
+}
+
+void BatchDecoder::on(MessageTag<MessageType::Snapshot>, const u_char *body,
+                      uint32_t size) {
+  if (size < sizeof(SnapshotHeader)) {
+    batch_->unhandled.push_back(MessageType::Snapshot);
+    return;
+  }
+  batch_->entries.push_back(
+      {EventType::Snapshot, static_cast<uint32_t>(wire_snapshots_.size())});
+  wire_snapshots_.push_back(reinterpret_cast<const SnapshotHeader *>(body));
+  wire_snapshot_sizes_.push_back(size);
+}
+
+void BatchDecoder::decode(const u_char *data, uint32_t len, EventBatch &batch) {
+  batch.clear();
+  wire_orders_.clear();
+  wire_trades_.clear();
+  wire_snapshots_.clear();
+  wire_snapshot_sizes_.clear();
+
+  // pass 1: walk headers and group messages by type
+  batch_ = &batch;
+  PackedMarketData mds(data, len);
+  for (const MdHeader *header = mds.next_md(); header != nullptr;
+       header = mds.next_md()) {
+    const u_char *body =
+        reinterpret_cast<const u_char *>(header) + sizeof(MdHeader);
+    // the last body may claim more than the message holds
+    uint32_t size = header->body_size();
+    if (body > data + len) {
+      size = 0;
+    } else if (size > static_cast<uint32_t>(data + len - body)) {
+      size = data + len - body;
+    }
+    dispatcher_.dispatch(*this, header->message_type(), body, size);
+  }
+  batch_ = nullptr;
+
+  // pass 2: convert each group in one go
+  batch.orders.resize(wire_orders_.size());
+  for (size_t i = 0; i < wire_orders_.size(); i++) {
+    decode_order(*wire_orders_[i], batch.orders[i]);
+  }
+  batch.trades.resize(wire_trades_.size());
+  for (size_t i = 0; i < wire_trades_.size(); i++) {
+    decode_trade(*wire_trades_[i], batch.trades[i]);
+  }
+  batch.snapshots.resize(wire_snapshots_.size());
+  for (size_t i = 0; i < wire_snapshots_.size(); i++) {
+    decode_snapshot(*wire_snapshots_[i], wire_snapshot_sizes_[i],
+                    batch.snapshots[i]);
+  }
+}
@@ -0,0 +1,122 @@
+#pragma once
+
+#include "common.h"
+#include "dispatch.h"
+#include "event.h"
+#include "order.h"
+#include "schema.h"
+#include "snapshot.h"
+#include "trade.h"
+
+#include <vector>
+
+namespace md {
+// events decoded from one market data message, storage is reused
+struct EventBatch {
+  // wire order of the events, which matters for arbitration
+  struct Entry {
+    EventType type;
+    uint32_t index;
+  };
+
+  std::vector<Entry> entries;
+  std::vector<OrderEvent> orders;
+  std::vector<TradeEvent> trades;
+  std::vector<SnapshotEvent> snapshots;
+  std::vector<schema::IndexSnapshot> index_snapshots;
+  std::vector<schema::SecurityStatus> security_statuses;
+  std::vector<schema::MarketStatus> market_statuses;
+  std::vector<schema::SnapshotStats> snapshot_stats;
+  // message types without a schema
+  std::vector<MessageType> unhandled;
+
+  void clear() {
+    entries.clear();
+    orders.clear();
+    trades.clear();
+    snapshots.clear();
+    index_snapshots.clear();
+    security_statuses.clear();
+    market_statuses.clear();
+    snapshot_stats.clear();
+    unhandled.clear();
+  }
+};
+
+// converts wire messages into host-endian events
+// messages are first grouped by type, then each group is converted in one
+// tight loop, swapping adjacent 64 bit fields pairwise with SSSE3 shuffles.
+// less frequent types are decoded right away by their schema decoders.
+class BatchDecoder {
+public:
+  // decode a whole (uncompressed) market data message
+  void decode(const u_char *data, uint32_t len, EventBatch &batch);
+
+  // decode index snapshot, security and market status and snapshot stats
+  // too, otherwise they are counted as unhandled like unknown types
+  void set_schema_messages(bool enabled) { schema_messages_ = enabled; }
+
+  // called by the dispatcher
+  void on(MessageTag<MessageType::Order>, const u_char *body, uint32_t size);
+  void on(MessageTag<MessageType::Trade>, const u_char *body, uint32_t size);
+  void on(MessageTag<MessageType::Snapshot>, const u_char *body,
+          uint32_t size);
+  void on(MessageTag<MessageType::IndexSnapshot>, const u_char *body,
+          uint32_t size) {
+    decode_schema(batch_->index_snapshots, EventType::IndexSnapshot,
+                  MessageType::IndexSnapshot, body, size);
+  }
+  void on(MessageTag<MessageType::SecurityStatus>, const u_char *body,
+          uint32_t size) {
+    decode_schema(batch_->security_statuses, EventType::SecurityStatus,
+                  MessageType::SecurityStatus, body, size);
+  }
+  void on(MessageTag<MessageType::MarketStatus>, const u_char *body,
+          uint32_t size) {
+    decode_schema(batch_->market_statuses, EventType::MarketStatus,
+                  MessageType::MarketStatus, body, size);
+  }
+  void on(MessageTag<MessageType::SnapshotStats>, const u_char *body,
+          uint32_t size) {
+    decode_schema(batch_->snapshot_stats, EventType::SnapshotStats,
+                  MessageType::SnapshotStats, body, size);
+  }
+  void on(MessageTag<MessageType::Heartbeat>, const u_char *body,
+          uint32_t size) {
+    // ignored
+  }
+  void on_unhandled(MessageType type, const u_char *body, uint32_t size) {
+    batch_->unhandled.push_back(type);
+  }
+
+private:
+  // messages too short for their own counts are unhandled as well
+  template <typename T>
+  void decode_schema(std::vector<T> &messages, EventType type,
+                     MessageType message_type, const u_char *body,
+                     uint32_t size) {
+    if (!schema_messages_) {
+      batch_->unhandled.push_back(message_type);
+      return;
+    }
+    messages.emplace_back();
+    if (T::decode(body, size, messages.back()) == nullptr) {
+      messages.pop_back();
+      batch_->unhandled.push_back(message_type);
+      return;
+    }
+    batch_->entries.push_back(
+        {type, static_cast<uint32_t>(messages.size() - 1)});
+  }
+
+  Dispatcher<BatchDecoder> dispatcher_;
+  // batch being decoded
+  EventBatch *batch_{nullptr};
+  bool schema_messages_{false};
+
+  std::vector<const Order *> wire_orders_;
+  std::vector<const Trade *> wire_trades_;
+  std::vector<const SnapshotHeader *> wire_snapshots_;
+  std::vector<uint32_t> wire_snapshot_sizes_;
+};
+} // namespace md
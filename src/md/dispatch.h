@@ -0,0 +1,98 @@
+#pragma once
+
+#include "common.h"
+
+#include <array>
+#include <type_traits>
+
+namespace md {
+template <MessageType T>
+using MessageTag = std::integral_constant<MessageType, T>;
+
+#define MD_MESSAGE_TYPES(X)                                                    \
+  X(Snapshot)                                                                  \
+  X(Trade)                                                                     \
+  X(Order)                                                                     \
+  X(IndexSnapshot)                                                             \
+  X(SecurityStatus)                                                            \
+  X(MarketStatus)                                                              \
+  X(Heartbeat)                                                                 \
+  X(SnapshotStats)
+
+#define MD_MESSAGE_TYPE_VALUE(name) static_cast<uint32_t>(MessageType::name),
+constexpr uint32_t KNOWN_MESSAGE_TYPES[] = {
+    MD_MESSAGE_TYPES(MD_MESSAGE_TYPE_VALUE)};
+#undef MD_MESSAGE_TYPE_VALUE
+
+constexpr size_t KNOWN_MESSAGE_TYPE_NUM =
+    sizeof(KNOWN_MESSAGE_TYPES) / sizeof(KNOWN_MESSAGE_TYPES[0]);
+
+// smallest modulus mapping every known type to a distinct slot, so the
+// sparse type numbers index a small dense table
+constexpr uint32_t find_dispatch_modulus() {
+  for (uint32_t m = KNOWN_MESSAGE_TYPE_NUM;; m++) {
+    bool distinct = true;
+    for (size_t i = 0; i < KNOWN_MESSAGE_TYPE_NUM && distinct; i++) {
+      for (size_t j = i + 1; j < KNOWN_MESSAGE_TYPE_NUM; j++) {
+        if (KNOWN_MESSAGE_TYPES[i] % m == KNOWN_MESSAGE_TYPES[j] % m) {
+          distinct = false;
+          break;
+        }
+      }
+    }
+    if (distinct) {
+      return m;
+    }
+  }
+}
+
+constexpr uint32_t DISPATCH_MODULUS = find_dispatch_modulus();
+static_assert(DISPATCH_MODULUS <= 64, "dispatch table got too sparse");
+
+// jump table over message types
+// Handler provides on(MessageTag<T>, body, size) for every known type and
+// on_unhandled(type, body, size) for anything else, size is the body_size of
+// the header, cut to what the message holds
+template <typename Handler> class Dispatcher {
+public:
+  Dispatcher() {
+    // a free slot holds a type mapping elsewhere, so no type matches it,
+    // not even 0 from zero padding
+    for (uint32_t slot = 0; slot < DISPATCH_MODULUS; slot++) {
+      types_[slot] = slot + 1;
+    }
+    table_.fill(nullptr);
+#define MD_REGISTER_MESSAGE_TYPE(name) add<MessageType::name>();
+    MD_MESSAGE_TYPES(MD_REGISTER_MESSAGE_TYPE)
+#undef MD_REGISTER_MESSAGE_TYPE
+  }
+
+  void dispatch(Handler &handler, MessageType type, const u_char *body,
+                uint32_t size) const {
+    uint32_t raw = static_cast<uint32_t>(type);
+    uint32_t slot = raw % DISPATCH_MODULUS;
+    if (types_[slot] != raw) {
+      handler.on_unhandled(type, body, size);
+      return;
+    }
+    table_[slot](handler, body, size);
+  }
+
+private:
+  using Fn = void (*)(Handler &, const u_char *, uint32_t);
+
+  template <MessageType T>
+  static void call(Handler &handler, const u_char *body, uint32_t size) {
+    handler.on(MessageTag<T>(), body, size);
+  }
+
+  template <MessageType T> void add() {
+    uint32_t raw = static_cast<uint32_t>(T);
+    types_[raw % DISPATCH_MODULUS] = raw;
+    table_[raw % DISPATCH_MODULUS] = &Dispatcher::call<T>;
+  }
+
+  std::array<uint32_t, DISPATCH_MODULUS> types_;
+  std::array<Fn, DISPATCH_MODULUS> table_;
+};
+} // namespace md
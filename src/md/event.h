@@ -0,0 +1,60 @@
+#pragma once
+
+#include "snapshot.h"
+
+#include <cstdint>
+
+namespace md {
+// normalised market data events
+// unlike the packed wire structs, fields are host-endian and naturally aligned
+// so they can be copied around (e.g. into shared memory) and read directly
+enum class EventType : uint32_t {
+  Order = 1,
+  Trade = 2,
+  Snapshot = 3,
+  // decoded from schema.h only, not published
+  IndexSnapshot = 4,
+  SecurityStatus = 5,
+  MarketStatus = 6,
+  SnapshotStats = 7,
+};
+
+struct OrderEvent {
+  uint64_t appl_seq_num;
+  int64_t price;
+  int64_t quantity;
+  int64_t transaction_time;
+  uint32_t security_id;
+  uint16_t channel_no;
+  char side;
+  char order_type;
+};
+
+struct TradeEvent {
+  uint64_t appl_seq_num;
+  uint64_t bid_appl_seq_num;
+  uint64_t offer_appl_seq_num;
+  int64_t price;
+  int64_t quantity;
+  int64_t transaction_time;
+  uint32_t security_id;
+  uint16_t channel_no;
+  char execute_type;
+};
+
+struct SnapshotEvent {
+  static const int DEPTH = 10;
+
+  int64_t orig_time;
+  int64_t total_trade_num;
+  int64_t total_trade_volume;
+  int64_t total_trade_value;
+  int64_t latest_trade_price;
+  int64_t open_price;
+  // index 0 is the best level
+  BookLevel bids[DEPTH];
+  BookLevel asks[DEPTH];
+  uint32_t security_id;
+  uint16_t channel_no;
+};
+} // namespace md
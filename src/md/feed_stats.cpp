@@ -0,0 +1,127 @@
+#include "feed_stats.h"
+#include "utils.h"
+
+using namespace md;
+
+namespace {
+// messages of a channel which may lie between the copies from two feeds
+const size_t WINDOW_SIZE = 4096;
+
+std::string bucket_to_string(int64_t bucket, int64_t utc_offset_seconds) {
+  int64_t seconds_of_day = (bucket + utc_offset_seconds) % 86400;
+  return timestamp_to_string(millis_to_exchange_time(seconds_of_day * 1000));
+}
+
+void write_summary(std::ostream &os, const Histogram &histogram) {
+  os << histogram.value_at(0.5) << ',' << histogram.value_at(0.9) << ','
+     << histogram.value_at(0.99) << ',' << histogram.value_at(0.999) << ','
+     << histogram.max() << ',';
+  histogram.write_bins(os);
+}
+} // namespace
+
+void FeedStats::on_sequenced(uint16_t channel_no, uint64_t appl_seq_num,
+                             bool won, const Arrival &arrival) {
+  auto &window = windows_[channel_no];
+  if (window.empty()) {
+    window.resize(WINDOW_SIZE, Copy{UINT64_MAX, 0, 0, true});
+  }
+  on_copy(channel_no, window[appl_seq_num % WINDOW_SIZE], appl_seq_num, won,
+          arrival);
+}
+
+void FeedStats::on_snapshot(uint16_t channel_no, uint32_t security_id,
+                            int64_t orig_time, bool won,
+                            const Arrival &arrival) {
+  auto found = snapshots_.find(security_id);
+  if (found == snapshots_.end()) {
+    found = snapshots_.emplace(security_id, Copy{UINT64_MAX, 0, 0, true}).first;
+  }
+  on_copy(channel_no, found->second, orig_time, won, arrival);
+}
+
+void FeedStats::on_copy(uint16_t channel_no, Copy &winner, uint64_t key,
+                        bool won, const Arrival &arrival) {
+  if (won) {
+    winner = Copy{key, arrival.pcap_ts, arrival.feed, false};
+    leads_[std::make_tuple(bucket_of(arrival.pcap_ts), channel_no,
+                           arrival.feed)]
+        .wins += 1;
+    return;
+  }
+  // a late copy from the winning feed itself is a retransmission
+  if (winner.key != key || winner.matched || winner.feed == arrival.feed) {
+    return;
+  }
+  winner.matched = true;
+  uint64_t lead =
+      arrival.pcap_ts > winner.pcap_ts ? arrival.pcap_ts - winner.pcap_ts : 0;
+  leads_[std::make_tuple(bucket_of(winner.pcap_ts), channel_no, winner.feed)]
+      .lead.record(lead);
+}
+
+void FeedStats::on_latency(MessageType type, int64_t exchange_time,
+                           const Arrival &arrival) {
+  int64_t latency =
+      static_cast<int64_t>(arrival.pcap_ts) -
+      exchange_time_to_epoch_micros(exchange_time, options_.utc_offset_seconds);
+  auto &entry = latencies_[std::make_pair(bucket_of(arrival.pcap_ts), type)];
+  if (latency < 0) {
+    entry.negative += 1;
+  } else {
+    entry.latency.record(latency);
+  }
+}
+
+void FeedStats::merge(const FeedStats &other) {
+  for (const auto &kv : other.leads_) {
+    auto &lead = leads_[kv.first];
+    lead.wins += kv.second.wins;
+    lead.lead.merge(kv.second.lead);
+  }
+  for (const auto &kv : other.latencies_) {
+    auto &latency = latencies_[kv.first];
+    latency.negative += kv.second.negative;
+    latency.latency.merge(kv.second.latency);
+  }
+}
+
+void FeedStats::write_leads(std::ostream &os) const {
+  os << "bucket,channel,feed,wins,winRatio,matched,leadP50,leadP90,leadP99,"
+        "leadP999,leadMax,leadBins\n";
+  for (auto it = leads_.begin(); it != leads_.end();) {
+    // all feeds of a channel in a bucket, for the win ratio
+    auto end = it;
+    uint64_t wins = 0;
+    while (end != leads_.end() &&
+           std::get<0>(end->first) == std::get<0>(it->first) &&
+           std::get<1>(end->first) == std::get<1>(it->first)) {
+      wins += end->second.wins;
+      ++end;
+    }
+    for (; it != end; ++it) {
+      const auto &lead = it->second;
+      os << bucket_to_string(std::get<0>(it->first),
+                             options_.utc_offset_seconds)
+         << ',' << std::get<1>(it->first) << ',' << std::get<2>(it->first)
+         << ',' << lead.wins << ','
+         << (wins == 0 ? 0.0 : static_cast<double>(lead.wins) / wins) << ','
+         << lead.lead.count() << ',';
+      write_summary(os, lead.lead);
+      os << '\n';
+    }
+  }
+}
+
+void FeedStats::write_latencies(std::ostream &os) const {
+  os << "bucket,messageType,count,negative,p50,p90,p99,p999,max,bins\n";
+  for (const auto &kv : latencies_) {
+    const auto &latency = kv.second;
+    os << bucket_to_string(kv.first.first, options_.utc_offset_seconds) << ','
+       << static_cast<uint32_t>(kv.first.second) << ','
+       << latency.latency.count() + latency.negative << ','
+       << latency.negative << ',';
+    write_summary(os, latency.latency);
+    os << '\n';
+  }
+}
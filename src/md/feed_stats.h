@@ -0,0 +1,101 @@
+#pragma once
+
+#include "common.h"
+#include "histogram.h"
+
+#include <cstdint>
+#include <iostream>
+#include <map>
+#include <tuple>
+#include <unordered_map>
+#include <vector>
+
+namespace md {
+// which feed a copy of a message came from and when it was captured
+struct Arrival {
+  uint32_t feed;
+  uint64_t pcap_ts;
+};
+
+struct FeedStatsOptions {
+  // histograms restart every bucket, to see intraday changes
+  int64_t bucket_seconds{300};
+  // exchange times are local, SZSE is UTC+8
+  int64_t utc_offset_seconds{8 * 3600};
+};
+
+// how often and by how much each feed wins arbitration, and how far capture
+// time lags exchange time, per time bucket of capture time
+//
+// the lead of a winning copy is measured when the other feed's copy of the
+// same message shows up, copies further apart than a window of messages in
+// a channel are not matched
+class FeedStats {
+public:
+  explicit FeedStats(FeedStatsOptions options = FeedStatsOptions())
+      : options_(options) {}
+
+  // a copy of an order or trade, won tells whether it is the first copy
+  void on_sequenced(uint16_t channel_no, uint64_t appl_seq_num, bool won,
+                    const Arrival &arrival);
+
+  // a copy of a snapshot, matched by security and exchange time
+  void on_snapshot(uint16_t channel_no, uint32_t security_id,
+                   int64_t orig_time, bool won, const Arrival &arrival);
+
+  // capture time minus exchange time of a message which won arbitration
+  void on_latency(MessageType type, int64_t exchange_time,
+                  const Arrival &arrival);
+
+  // add up stats of another thread, e.g. of other channels
+  void merge(const FeedStats &other);
+
+  // bucket,channel,feed,wins,winRatio,matched,leadP50,...,leadMax,leadBins
+  void write_leads(std::ostream &os) const;
+
+  // bucket,messageType,count,negative,p50,...,max,bins
+  void write_latencies(std::ostream &os) const;
+
+private:
+  struct Copy {
+    uint64_t key; // appl seq num, or orig time of a snapshot
+    uint64_t pcap_ts;
+    uint32_t feed;
+    bool matched;
+  };
+
+  struct Lead {
+    uint64_t wins{0};
+    // micro seconds ahead of the other feed, one per matched message
+    Histogram lead;
+  };
+
+  struct Latency {
+    // capture before exchange time, clocks out of sync
+    uint64_t negative{0};
+    // micro seconds
+    Histogram latency;
+  };
+
+  // first second of the bucket a capture time falls in
+  int64_t bucket_of(uint64_t pcap_ts) const {
+    int64_t seconds = pcap_ts / 1000000;
+    return seconds - seconds % options_.bucket_seconds;
+  }
+
+  void on_copy(uint16_t channel_no, Copy &winner, uint64_t key, bool won,
+               const Arrival &arrival);
+
+  FeedStatsOptions options_;
+
+  // recent winning copies of a channel, indexed by appl seq num
+  std::unordered_map<uint16_t, std::vector<Copy>> windows_;
+  // last winning snapshot copy of a security
+  std::unordered_map<uint32_t, Copy> snapshots_;
+
+  // key: bucket, channel, feed
+  std::map<std::tuple<int64_t, uint16_t, uint32_t>, Lead> leads_;
+  // key: bucket, message type
+  std::map<std::pair<int64_t, MessageType>, Latency> latencies_;
+};
+} // namespace md
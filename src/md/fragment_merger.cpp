@@ -0,0 +1,177 @@
+#include "fragment_merger.h"
+
+#include <cstring>
+
+using namespace md;
+
+namespace {
+// one round of xxhash64
+inline uint64_t fold(uint64_t state, uint64_t value) {
+  state += value * 0xc2b2ae3d27d4eb4fULL;
+  state = (state << 31) | (state >> 33);
+  return state * 0x9e3779b185ebca87ULL;
+}
+
+// identical for the same fragment of a message on either feed
+uint64_t fragment_key(const UdpPayload &payload, uint32_t packet_index) {
+  uint64_t state = fold(payload.channel_id(),
+                        static_cast<uint64_t>(payload.total_packet_number())
+                                << 32 |
+                            packet_index);
+  const u_char *body = payload.body();
+  uint32_t size = payload.body_size();
+  uint32_t i = 0;
+  for (; i + 8 <= size; i += 8) {
+    uint64_t word;
+    std::memcpy(&word, body + i, sizeof(word));
+    state = fold(state, word);
+  }
+  uint64_t tail = 0;
+  std::memcpy(&tail, body + i, size - i);
+  return fold(state, tail ^ size);
+}
+} // namespace
+
+const Message *FragmentMerger::add(uint32_t feed, const UdpPayload &payload,
+                                   bool &completed) {
+  completed = false;
+  uint16_t packet_num = payload.total_packet_number();
+  uint32_t packet_index =
+      payload.current_packet_index() + payload.initial_packet_index();
+  if (feed >= MAX_FEEDS || packet_index >= packet_num ||
+      payload.body_size() > Buffer::MAX_PACKET_LEN) {
+    return nullptr;
+  }
+  stats_.fragments += 1;
+
+  auto &channel = channels_[payload.channel_id()];
+  uint64_t key = fragment_key(payload, packet_index);
+
+  uint64_t grouped = 0;
+  auto group = channel.groups[feed].find(payload.sequence_id());
+  if (group != channel.groups[feed].end()) {
+    grouped = group->second;
+  }
+  // the same bytes at the same index, compared in case of a collision
+  uint64_t matched = 0;
+  auto fragment = channel.fragments.find(key);
+  if (fragment != channel.fragments.end()) {
+    const auto &assembly = assemblies_[fragment->second];
+    if (assembly.packet_num == packet_num &&
+        std::memcmp(assembly.buffer.packet(packet_index), payload.body(),
+                    payload.body_size()) == 0) {
+      matched = fragment->second;
+    }
+  }
+
+  uint64_t id = grouped != 0 ? grouped : matched;
+  if (id == 0) {
+    id = create(channel, payload);
+  } else if (grouped != 0 && matched != 0 && grouped != matched) {
+    // each feed started its own copy before they shared a fragment
+    id = merge(channel, matched, grouped);
+  } else if (grouped == 0) {
+    stats_.merged += 1;
+  }
+  auto &assembly = assemblies_[id];
+  if (assembly.packet_num != packet_num) {
+    // same sequence id, different message, keep the first
+    return nullptr;
+  }
+  if (channel.groups[feed].emplace(payload.sequence_id(), id).second) {
+    assembly.groups.emplace_back(feed, payload.sequence_id());
+  }
+
+  if (assembly.completed) {
+    completed = true;
+    stats_.duplicates += 1;
+    return nullptr;
+  }
+  if (!assembly.buffer.filled(packet_index)) {
+    assembly.buffer.fill(packet_index, payload.body(), payload.body_size());
+    if (channel.fragments.emplace(key, id).second) {
+      assembly.keys.push_back(key);
+    }
+  }
+  if (!assembly.buffer.full()) {
+    return nullptr;
+  }
+
+  assembly.completed = true;
+  completed = true;
+  stats_.completed += 1;
+  return reinterpret_cast<const Message *>(assembly.buffer.data());
+}
+
+uint64_t FragmentMerger::create(Channel &channel, const UdpPayload &payload) {
+  uint64_t id = next_id_++;
+  auto &assembly = assemblies_[id];
+  assembly.channel_id = payload.channel_id();
+  assembly.packet_num = payload.total_packet_number();
+  assembly.buffer.reserve(assembly.packet_num);
+  channel.order.push_back(id);
+  if (channel.order.size() > capacity_) {
+    evict(channel);
+  }
+  return id;
+}
+
+uint64_t FragmentMerger::merge(Channel &channel, uint64_t into,
+                               uint64_t from) {
+  // a message handed out stays the one, so it is never handed out twice
+  if (assemblies_[from].completed) {
+    std::swap(into, from);
+  }
+  auto &target = assemblies_[into];
+  auto &source = assemblies_[from];
+  if (target.packet_num != source.packet_num) {
+    return into;
+  }
+  if (!target.completed) {
+    for (uint16_t i = 0; i < source.packet_num; ++i) {
+      if (source.buffer.filled(i) && !target.buffer.filled(i)) {
+        target.buffer.fill(i, source.buffer.packet(i), Buffer::MAX_PACKET_LEN);
+      }
+    }
+  }
+  for (uint64_t key : source.keys) {
+    auto &entry = channel.fragments[key];
+    entry = into;
+    target.keys.push_back(key);
+  }
+  for (const auto &group : source.groups) {
+    channel.groups[group.first][group.second] = into;
+    target.groups.push_back(group);
+  }
+  // its slot in channel.order is skipped when evicted
+  assemblies_.erase(from);
+  return into;
+}
+
+void FragmentMerger::evict(Channel &channel) {
+  while (channel.order.size() > capacity_) {
+    uint64_t id = channel.order.front();
+    channel.order.pop_front();
+    auto found = assemblies_.find(id);
+    if (found == assemblies_.end()) {
+      continue;
+    }
+    const auto &assembly = found->second;
+    if (!assembly.completed) {
+      stats_.evicted += 1;
+    }
+    for (uint64_t key : assembly.keys) {
+      auto entry = channel.fragments.find(key);
+      if (entry != channel.fragments.end() && entry->second == id) {
+        channel.fragments.erase(entry);
+      }
+    }
+    for (const auto &group : assembly.groups) {
+      auto entry = channel.groups[group.first].find(group.second);
+      if (entry != channel.groups[group.first].end() && entry->second == id) {
+        channel.groups[group.first].erase(entry);
+      }
+    }
+    assemblies_.erase(found);
+  }
+}
@@ -0,0 +1,78 @@
+#pragma once
+
+#include "preprocessor.h"
+
+#include <cstdint>
+#include <deque>
+#include <unordered_map>
+#include <vector>
+
+namespace md {
+// one reassembly area for the fragments of both feeds
+//
+// the feeds number their packets independently, so fragments are matched by
+// content: a fragment of one feed joins the message holding the same bytes
+// at the same index from the other feed. within a feed, fragments still
+// group by sequence id. a message completes as soon as its fragments from
+// either feed fill it, is handed out once, and stays as a tombstone so the
+// late fragments of the other feed are dropped without copying.
+//
+// messages are kept per channel in arrival order and the oldest is evicted
+// beyond capacity, so partial messages of a dropped fragment do not pile up.
+// like the pruner, one merger is shared by the processors of both feeds
+class FragmentMerger {
+public:
+  static const uint32_t MAX_FEEDS = 2;
+
+  struct Stats {
+    uint64_t fragments{0};
+    // fragments of a message started by the other feed
+    uint64_t merged{0};
+    uint64_t completed{0};
+    // fragments of messages already completed
+    uint64_t duplicates{0};
+    // partial messages given up
+    uint64_t evicted{0};
+  };
+
+  explicit FragmentMerger(size_t capacity = 256) : capacity_(capacity) {}
+
+  // the message the fragment completes, valid until the next call, or
+  // nullptr. completed is set if the message is complete, now or before
+  const Message *add(uint32_t feed, const UdpPayload &payload,
+                     bool &completed);
+
+  const Stats &stats() const { return stats_; }
+
+private:
+  struct Assembly {
+    uint32_t channel_id;
+    uint16_t packet_num;
+    bool completed{false};
+    Buffer buffer;
+    // index entries pointing here, removed with it
+    std::vector<uint64_t> keys;
+    std::vector<std::pair<uint32_t, int64_t>> groups;
+  };
+
+  struct Channel {
+    // content hash of a fragment -> message
+    std::unordered_map<uint64_t, uint64_t> fragments;
+    // sequence id of each feed -> message
+    std::unordered_map<int64_t, uint64_t> groups[MAX_FEEDS];
+    // message ids by age, merged ones are skipped when evicted
+    std::deque<uint64_t> order;
+  };
+
+  uint64_t create(Channel &channel, const UdpPayload &payload);
+  // one message of two, returns the id kept
+  uint64_t merge(Channel &channel, uint64_t into, uint64_t from);
+  void evict(Channel &channel);
+
+  size_t capacity_;
+  uint64_t next_id_{1};
+  std::unordered_map<uint32_t, Channel> channels_;
+  std::unordered_map<uint64_t, Assembly> assemblies_;
+  Stats stats_;
+};
+} // namespace md
@@ -0,0 +1,88 @@
+#pragma once
+
+#include <cstdint>
+#include <iostream>
+#include <vector>
+
+namespace md {
+// log-linear histogram of non-negative values, like HdrHistogram
+//
+// values below 64 are exact, above that every power of 2 is split into 32
+// bins, so a bin is at most ~3% wide. bins are allocated as values grow.
+class Histogram {
+public:
+  void record(uint64_t value) {
+    size_t index = index_of(value);
+    if (index >= counts_.size()) {
+      counts_.resize(index + 1, 0);
+    }
+    counts_[index] += 1;
+    total_ += 1;
+    if (value > max_) {
+      max_ = value;
+    }
+  }
+
+  void merge(const Histogram &other) {
+    if (other.counts_.size() > counts_.size()) {
+      counts_.resize(other.counts_.size(), 0);
+    }
+    for (size_t i = 0; i < other.counts_.size(); i++) {
+      counts_[i] += other.counts_[i];
+    }
+    total_ += other.total_;
+    if (other.max_ > max_) {
+      max_ = other.max_;
+    }
+  }
+
+  uint64_t count() const { return total_; }
+
+  uint64_t max() const { return max_; }
+
+  // lowest value of the bin holding the given quantile, 0 when empty
+  uint64_t value_at(double quantile) const {
+    uint64_t rank = static_cast<uint64_t>(quantile * total_);
+    uint64_t seen = 0;
+    for (size_t i = 0; i < counts_.size(); i++) {
+      seen += counts_[i];
+      if (seen > rank) {
+        return lowest_of(i);
+      }
+    }
+    return max_;
+  }
+
+  // non-empty bins as "value:count|value:count"
+  void write_bins(std::ostream &os) const {
+    const char *separator = "";
+    for (size_t i = 0; i < counts_.size(); i++) {
+      if (counts_[i] != 0) {
+        os << separator << lowest_of(i) << ':' << counts_[i];
+        separator = "|";
+      }
+    }
+  }
+
+private:
+  static size_t index_of(uint64_t value) {
+    if (value < 64) {
+      return value;
+    }
+    int shift = 63 - __builtin_clzll(value) - 5;
+    return shift * 32 + (value >> shift);
+  }
+
+  static uint64_t lowest_of(size_t index) {
+    if (index < 64) {
+      return index;
+    }
+    int shift = index / 32 - 1;
+    return static_cast<uint64_t>(index % 32 + 32) << shift;
+  }
+
+  std::vector<uint64_t> counts_;
+  uint64_t total_{0};
+  uint64_t max_{0};
+};
+} // namespace md
@@ -1,38 +1,66 @@
 #include "preprocessor.h"
+#include "fragment_merger.h"
 #include "utils.h"
+#include "../diag/logger.h"
 
 using namespace md;
 
-bool is_valid_packet(const udphdr &udp_header, const u_char *udp_payload) {
-  uint16_t length = ntohs(udp_header.len);
-
+bool is_valid_packet(const UdpPacket &packet) {
   // we always assume this is a market data packet
   const auto *payload_header =
-      reinterpret_cast<const md::UdpPayload *>(udp_payload);
-
-  if (length ==
-      payload_header->body_size() + sizeof(udphdr) + sizeof(md::UdpPayload)) {
+      reinterpret_cast<const md::UdpPayload *>(packet.payload);
+
+  // the body is read from what was captured, a truncated packet (snaplen,
+  // or the slot of a worker queue) is as invalid as a malformed one
+  if (packet.captured >= sizeof(md::UdpPayload) &&
+      sizeof(md::UdpPayload) + payload_header->body_size() <=
+          packet.captured &&
+      packet.length == payload_header->body_size() + sizeof(udphdr) +
+                           sizeof(md::UdpPayload)) {
     return true;
   }
-  std::cerr << "find a udp packet does not match our protocol, source port: "
-            << ntohs(udp_header.source)
-            << ", dest port: " << ntohs(udp_header.dest)
-            << ", length: " << length << std::endl;
-  md::print_hex_array(udp_payload, length);
+  diag::log(diag::Event::InvalidPacket, packet.source_port, packet.dest_port,
+            packet.length, packet.payload,
+            std::min<uint32_t>(packet.length, packet.captured));
   return false;
 }
 
-void MdPreprocessor::process(const udphdr &udp_header,
-                             const u_char *udp_payload) {
+void MdPreprocessor::process_batch(const UdpPacket *packets, size_t count) {
+  // payloads of a large batch no longer sit in L1 when their turn comes
+  const size_t distance = 4;
+  for (size_t i = 0; i < count; ++i) {
+    if (i + distance < count) {
+      __builtin_prefetch(packets[i + distance].payload);
+    }
+    process(packets[i]);
+  }
+}
+
+void MdPreprocessor::process(const UdpPacket &packet) {
 
-  assert(udp_payload != nullptr);
-  if (is_valid_packet(udp_header, udp_payload) == false) {
+  assert(packet.payload != nullptr);
+  if (is_valid_packet(packet) == false) {
     return;
   }
 
-  const auto &payload = *reinterpret_cast<const UdpPayload *>(udp_payload);
+  const auto &payload = *reinterpret_cast<const UdpPayload *>(packet.payload);
+
+  auto found = msg_managers_.find(payload.channel_id());
+  if (found == msg_managers_.end()) {
+    found = msg_managers_
+                .emplace(payload.channel_id(),
+                         MessageManager(merger_, merger_feed_))
+                .first;
+  }
+  auto &msg_manager = found->second;
 
-  auto &msg_manager = msg_managers_[payload.channel_id()];
+  if (pruner_ != nullptr &&
+      !pruner_->wants(payload.channel_id(),
+                      payload.total_packet_number() == 1)) {
+    bool new_message = msg_manager.skip(payload);
+    pruner_->count_pruned(payload.body_size(), new_message);
+    return;
+  }
 
   msg_manager.handle(payload);
 
@@ -51,7 +79,11 @@ void MdPreprocessor::process(const udphdr &udp_header,
   //           << ": ";
   // print_hex_array(raw_md, msg->size_before_compress());
 
-  md_handler_(raw_md, msg->size_before_compress());
+  if (pruner_ != nullptr && pruner_->learning(payload.channel_id())) {
+    pruner_->learn(payload.channel_id(), raw_md, msg->size_before_compress());
+  }
+
+  md_handler_(raw_md, msg->size_before_compress(), packet);
 }
 
 const u_char *MdPreprocessor::uncompress_message(const Message &message) {
@@ -72,11 +104,9 @@ const u_char *MdPreprocessor::uncompress_message(const Message &message) {
   assert(decompressed_size == message.size_before_compress());
 
   if (result != Z_OK) {
-    std::cerr << "uncompress failed with code " << result
-              << ", skip this message: " << '\n';
-
-    print_hex_array(message.body() - sizeof(Message),
-                    sizeof(Message) + message.size_after_compress());
+    diag::log(diag::Event::InflateFailed, result, 0, 0,
+              message.body() - sizeof(Message),
+              sizeof(Message) + message.size_after_compress());
     return nullptr;
   }
 
@@ -98,13 +128,12 @@ void Buffer::fill(uint16_t packet_index, const u_char *src, uint32_t length) {
 }
 
 bool MessageManager::handle(const UdpPayload &payload) {
-  // seq gap, print a warn and ignore
-  if (payload.sequence_id() != last_seq_id_ + 1) {
-    std::cout << " channel " << payload.channel_id()
-              << " gets seq gap in packet with seq: " << payload.sequence_id()
-              << ", current seq: " << last_seq_id_ << '\n';
-    print_hex_array(reinterpret_cast<const u_char *>(&payload),
-                    sizeof(UdpPayload) + payload.body_size());
+  // seq gap, print a warn and ignore. fragments of a message completed
+  // through the other feed come after last_seq_id_ moved on to it
+  if (payload.sequence_id() > last_seq_id_ + 1) {
+    diag::log(diag::Event::SeqGap, payload.channel_id(), payload.sequence_id(),
+              last_seq_id_, reinterpret_cast<const u_char *>(&payload),
+              sizeof(UdpPayload) + payload.body_size());
   }
 
   if (payload.total_packet_number() != 1) {
@@ -118,7 +147,34 @@ bool MessageManager::handle(const UdpPayload &payload) {
   return true;
 }
 
+bool MessageManager::skip(const UdpPayload &payload) {
+  // fragments of one message share the sequence id
+  if (payload.sequence_id() <= last_seq_id_) {
+    return false;
+  }
+  if (payload.sequence_id() != last_seq_id_ + 1) {
+    diag::log(diag::Event::SeqGap, payload.channel_id(), payload.sequence_id(),
+              last_seq_id_, reinterpret_cast<const u_char *>(&payload),
+              sizeof(UdpPayload) + payload.body_size());
+  }
+  last_seq_id_ = payload.sequence_id();
+  // partial messages from before pruning would never complete
+  storage_.erase(storage_.begin(), storage_.upper_bound(last_seq_id_));
+  return true;
+}
+
 void MessageManager::store(const UdpPayload &payload) {
+  if (merger_ != nullptr) {
+    bool completed = false;
+    realtime_msg_ = merger_->add(feed_, payload, completed);
+    if (completed && realtime_msg_ == nullptr &&
+        payload.sequence_id() > last_seq_id_) {
+      // handed out through the other feed, counts as processed here
+      last_seq_id_ = payload.sequence_id();
+    }
+    return;
+  }
+
   if (storage_.find(payload.sequence_id()) == storage_.end()) {
     storage_[payload.sequence_id()].reserve(payload.total_packet_number());
   }
@@ -1,6 +1,7 @@
 #pragma once
 
 #include "../pcap/udp_packet_processor.h"
+#include "channel_pruner.h"
 
 #include <algorithm>
 #include <functional>
@@ -75,6 +76,18 @@ public:
 
   void fill(uint16_t packet_index, const u_char *src, uint32_t length);
 
+  bool filled(uint16_t packet_index) const {
+    return packet_index < filled_.size() && filled_[packet_index];
+  }
+
+  // slot of one packet, MAX_PACKET_LEN long
+  const u_char *packet(uint16_t packet_index) const {
+    return raw_data_.get() + packet_index * MAX_PACKET_LEN;
+  }
+
+  // all packets, a message once full()
+  const u_char *data() const { return raw_data_.get(); }
+
   bool full() const {
     return filled_.empty() == false &&
            std::all_of(filled_.begin(), filled_.end(),
@@ -92,15 +105,26 @@ private:
   std::unique_ptr<u_char[]> raw_data_;
 };
 
+class FragmentMerger;
+
 // for every channel, the manager works to:
 //  1. construct message from udp packets
 //  2. drop outdated/duplicated udp packet
+// with a merger, fragments are reassembled there together with the other
+// feed's instead of in storage_
 class MessageManager {
 public:
+  explicit MessageManager(FragmentMerger *merger = nullptr, uint32_t feed = 0)
+      : merger_(merger), feed_(feed) {}
+
   // returns whether the payload contains a new message
   bool handle(const UdpPayload &payload);
   const Message *consume_message(int64_t seq_id);
 
+  // account for a packet which is not processed, e.g. pruned channel
+  // returns whether it starts a new message
+  bool skip(const UdpPayload &payload);
+
 private:
   // this is set to the latest "processed" message, -1 means no previous message
   // we only drop outdated message, do nothing for out-ordered ones
@@ -108,7 +132,11 @@ private:
   std::map<int64_t, Buffer> storage_;
   void store(const UdpPayload &payload);
 
-  // message from current packet, guaranteed to be a whole message or nullptr
+  FragmentMerger *merger_;
+  uint32_t feed_;
+
+  // message from current packet, or completed by it in the merger
+  // guaranteed to be a whole message or nullptr
   const Message *realtime_msg_{nullptr};
   // message constructed from storage
   std::unique_ptr<u_char[]> cached_msg_;
@@ -120,16 +148,34 @@ private:
 //  2. uncompress message if needed
 class MdPreprocessor : public UdpPacketProcessor {
 public:
-  using MdHandler = std::function<void(const u_char *, uint32_t)>;
+  // the packet is the one completing the message
+  using MdHandler =
+      std::function<void(const u_char *, uint32_t, const UdpPacket &)>;
 
   MdPreprocessor(std::string net, std::string netmask, MdHandler handler)
       : UdpPacketProcessor(net, netmask), md_handler_(handler) {}
 
   // override UdpPacketProcessor::process
-  void process(const udphdr &udp_header, const u_char *udp_payload) override;
+  void process(const UdpPacket &packet) override;
+
+  // prefetches payloads a few packets ahead
+  void process_batch(const UdpPacket *packets, size_t count) override;
+
+  // not owned, can be shared by processors of both feeds
+  void set_pruner(ChannelPruner *pruner) { pruner_ = pruner; }
+
+  // not owned, shared with the processor of the other feed, which is given
+  // another feed number. set before the first packet
+  void set_merger(FragmentMerger *merger, uint32_t feed) {
+    merger_ = merger;
+    merger_feed_ = feed;
+  }
 
 private:
   MdHandler md_handler_;
+  ChannelPruner *pruner_{nullptr};
+  FragmentMerger *merger_{nullptr};
+  uint32_t merger_feed_{0};
 
   // we need to hold these message until next comes
   std::unique_ptr<u_char[]> decompressed_message_;
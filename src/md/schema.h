@@ -0,0 +1,285 @@
+#pragma once
+
+#include <cstdint>
+#include <cstring>
+#include <endian.h>
+#include <ostream>
+#include <string>
+#include <sys/types.h>
+#include <vector>
+
+// wire layouts of every SZSE binary message body we know, the one place to
+// describe them. from each layout MD_DEFINE_MESSAGE generates
+//   - Name::Wire, the packed big-endian wire struct
+//   - Name itself, with host-endian members of the same names
+//   - Name::decode(), straight-line code with compile-time offsets, with an
+//     overload checking the body is large enough
+//   - Name::csv_header() / write_csv(), the matching csv columns
+//
+// X(codec, name): codec is one of the field codecs below
+namespace md {
+namespace schema {
+
+// field codecs
+template <typename T> struct BigEndian {
+  using wire_type = T;
+  using value_type = T;
+
+  static T decode(const u_char *p) {
+    T v;
+    std::memcpy(&v, p, sizeof(v));
+    return swap(v);
+  }
+
+  static void write(std::ostream &os, T v) { os << +v; }
+
+private:
+  static uint16_t swap(uint16_t v) { return be16toh(v); }
+  static uint32_t swap(uint32_t v) { return be32toh(v); }
+  static uint64_t swap(uint64_t v) { return be64toh(v); }
+  static int64_t swap(int64_t v) { return be64toh(v); }
+};
+
+using U16 = BigEndian<uint16_t>;
+using U32 = BigEndian<uint32_t>;
+using U64 = BigEndian<uint64_t>;
+using I64 = BigEndian<int64_t>;
+
+// fixed size text, right padded with spaces
+template <size_t N> struct FixedString {
+  char data[N];
+
+  std::string str() const {
+    size_t len = N;
+    while (len > 0 && (data[len - 1] == ' ' || data[len - 1] == '\0')) {
+      --len;
+    }
+    return std::string(data, len);
+  }
+};
+
+template <size_t N> struct Chars {
+  using wire_type = char[N];
+  using value_type = FixedString<N>;
+
+  static value_type decode(const u_char *p) {
+    value_type v;
+    std::memcpy(v.data, p, N);
+    return v;
+  }
+
+  static void write(std::ostream &os, const value_type &v) { os << v.str(); }
+};
+
+struct Char {
+  using wire_type = char;
+  using value_type = char;
+
+  static char decode(const u_char *p) { return static_cast<char>(*p); }
+
+  static void write(std::ostream &os, char v) { os << v; }
+};
+
+#define MD_WIRE_FIELD(codec, name) codec::wire_type name;
+#define MD_VALUE_FIELD(codec, name) codec::value_type name;
+#define MD_DECODE_FIELD(codec, name)                                           \
+  out.name = codec::decode(reinterpret_cast<const u_char *>(&wire.name));
+#define MD_FIELD_NAME(codec, name) #name ","
+#define MD_WRITE_FIELD(codec, name)                                            \
+  os << separator;                                                             \
+  separator = sep_str;                                                         \
+  codec::write(os, name);
+
+#define MD_DEFINE_MESSAGE(Name, FIELDS)                                        \
+  struct Name {                                                                \
+    struct __attribute__((packed)) Wire {                                      \
+      FIELDS(MD_WIRE_FIELD)                                                    \
+    };                                                                         \
+                                                                               \
+    FIELDS(MD_VALUE_FIELD)                                                     \
+                                                                               \
+    static const u_char *decode(const u_char *p, Name &out) {                  \
+      const Wire &wire = *reinterpret_cast<const Wire *>(p);                   \
+      FIELDS(MD_DECODE_FIELD)                                                  \
+      return p + sizeof(Wire);                                                 \
+    }                                                                          \
+                                                                               \
+    /* nullptr if size is too short */                                        \
+    static const u_char *decode(const u_char *p, uint32_t size, Name &out) {   \
+      return size < sizeof(Wire) ? nullptr : decode(p, out);                   \
+    }                                                                          \
+                                                                               \
+    static std::string csv_header() {                                          \
+      std::string header = FIELDS(MD_FIELD_NAME);                              \
+      header.pop_back();                                                       \
+      return header;                                                           \
+    }                                                                          \
+                                                                               \
+    void write_csv(std::ostream &os, char sep = ',') const {                   \
+      const char *separator = "";                                              \
+      char sep_str[2] = {sep, '\0'};                                           \
+      FIELDS(MD_WRITE_FIELD)                                                   \
+    }                                                                          \
+  };
+
+// a head followed by a repeated group, the count is a field of the head
+// entries are written into one csv column as "f1:f2|f1:f2"
+template <typename Head, typename Entry, uint32_t Head::*Count>
+struct Grouped {
+  Head head;
+  std::vector<Entry> entries;
+
+  // nullptr if the head or the entries it counts do not fit in size, the
+  // count comes from the wire and is not trusted
+  static const u_char *decode(const u_char *p, uint32_t size, Grouped &out) {
+    const size_t head_size = sizeof(typename Head::Wire);
+    const size_t entry_size = sizeof(typename Entry::Wire);
+    if (size < head_size) {
+      return nullptr;
+    }
+    p = Head::decode(p, out.head);
+    uint32_t count = out.head.*Count;
+    if (count > (size - head_size) / entry_size) {
+      return nullptr;
+    }
+    out.entries.resize(count);
+    for (auto &entry : out.entries) {
+      p = Entry::decode(p, entry);
+    }
+    return p;
+  }
+
+  static std::string csv_header() { return Head::csv_header() + ",entries"; }
+
+  void write_csv(std::ostream &os) const {
+    head.write_csv(os);
+    os << ',';
+    for (size_t i = 0; i < entries.size(); i++) {
+      if (i > 0) {
+        os << '|';
+      }
+      entries[i].write_csv(os, ':');
+    }
+  }
+};
+
+// 300192
+#define MD_ORDER_FIELDS(X)                                                     \
+  X(U16, channel_no)                                                           \
+  X(U64, appl_seq_num)                                                         \
+  X(Chars<3>, md_stream_id)                                                    \
+  X(Chars<8>, security_id)                                                     \
+  X(Chars<4>, security_id_source)                                              \
+  X(I64, price)                                                                \
+  X(I64, order_qty)                                                            \
+  X(Char, side)                                                                \
+  X(I64, transact_time)                                                        \
+  X(Char, ord_type)
+
+// 300191
+#define MD_TRADE_FIELDS(X)                                                     \
+  X(U16, channel_no)                                                           \
+  X(U64, appl_seq_num)                                                         \
+  X(Chars<3>, md_stream_id)                                                    \
+  X(U64, bid_appl_seq_num)                                                     \
+  X(U64, offer_appl_seq_num)                                                   \
+  X(Chars<8>, security_id)                                                     \
+  X(Chars<4>, security_id_source)                                              \
+  X(I64, last_px)                                                              \
+  X(I64, last_qty)                                                             \
+  X(Char, exec_type)                                                           \
+  X(I64, transact_time)
+
+// common head of 300111 and 309011
+#define MD_SNAPSHOT_HEAD_FIELDS(X)                                             \
+  X(I64, orig_time)                                                            \
+  X(U16, channel_no)                                                           \
+  X(Chars<3>, md_stream_id)                                                    \
+  X(Chars<8>, security_id)                                                     \
+  X(Chars<4>, security_id_source)                                              \
+  X(Chars<8>, trading_phase_code)                                              \
+  X(I64, prev_close_px)                                                        \
+  X(I64, num_trades)                                                           \
+  X(I64, total_volume_trade)                                                   \
+  X(I64, total_value_trade)                                                    \
+  X(U32, no_md_entries)
+
+// entry of 300111, followed by no_orders * Int64 quantities
+#define MD_SNAPSHOT_ENTRY_FIELDS(X)                                            \
+  X(Chars<2>, md_entry_type)                                                   \
+  X(I64, md_entry_px)                                                          \
+  X(I64, md_entry_size)                                                        \
+  X(U16, md_price_level)                                                       \
+  X(I64, number_of_orders)                                                     \
+  X(U32, no_orders)
+
+// entry of 309011
+#define MD_INDEX_SNAPSHOT_ENTRY_FIELDS(X)                                      \
+  X(Chars<2>, md_entry_type)                                                   \
+  X(I64, md_entry_px)
+
+// 390013
+#define MD_SECURITY_STATUS_HEAD_FIELDS(X)                                      \
+  X(I64, orig_time)                                                            \
+  X(U16, channel_no)                                                           \
+  X(Chars<8>, security_id)                                                     \
+  X(Chars<4>, security_id_source)                                              \
+  X(Chars<8>, financial_status)                                                \
+  X(U32, no_switch)
+
+#define MD_SECURITY_SWITCH_FIELDS(X)                                           \
+  X(U16, security_switch_type)                                                 \
+  X(U16, security_switch_status)
+
+// 390019
+#define MD_MARKET_STATUS_FIELDS(X)                                             \
+  X(I64, orig_time)                                                            \
+  X(U16, channel_no)                                                           \
+  X(Chars<8>, market_id)                                                       \
+  X(Chars<8>, market_segment_id)                                               \
+  X(Chars<4>, trading_session_id)                                              \
+  X(Chars<4>, trading_session_sub_id)                                          \
+  X(U16, trad_ses_status)                                                      \
+  X(I64, trad_ses_start_time)                                                  \
+  X(I64, trad_ses_end_time)                                                    \
+  X(I64, threshold_amount)                                                     \
+  X(I64, pos_amt)                                                              \
+  X(Char, amount_status)
+
+// 390090
+#define MD_SNAPSHOT_STATS_HEAD_FIELDS(X)                                       \
+  X(I64, orig_time)                                                            \
+  X(U16, channel_no)                                                           \
+  X(U32, no_md_stream_id)
+
+#define MD_SNAPSHOT_STATS_ENTRY_FIELDS(X)                                      \
+  X(Chars<3>, md_stream_id)                                                    \
+  X(U32, stock_num)                                                            \
+  X(Chars<8>, trading_phase_code)
+
+// 390095
+#define MD_HEARTBEAT_FIELDS(X)                                                 \
+  X(U16, channel_no)                                                           \
+  X(I64, appl_last_seq_num)                                                    \
+  X(U16, end_of_channel)
+
+MD_DEFINE_MESSAGE(Order, MD_ORDER_FIELDS)
+MD_DEFINE_MESSAGE(Trade, MD_TRADE_FIELDS)
+MD_DEFINE_MESSAGE(SnapshotHead, MD_SNAPSHOT_HEAD_FIELDS)
+MD_DEFINE_MESSAGE(SnapshotEntry, MD_SNAPSHOT_ENTRY_FIELDS)
+MD_DEFINE_MESSAGE(IndexSnapshotEntry, MD_INDEX_SNAPSHOT_ENTRY_FIELDS)
+MD_DEFINE_MESSAGE(SecurityStatusHead, MD_SECURITY_STATUS_HEAD_FIELDS)
+MD_DEFINE_MESSAGE(SecuritySwitch, MD_SECURITY_SWITCH_FIELDS)
+MD_DEFINE_MESSAGE(MarketStatus, MD_MARKET_STATUS_FIELDS)
+MD_DEFINE_MESSAGE(SnapshotStatsHead, MD_SNAPSHOT_STATS_HEAD_FIELDS)
+MD_DEFINE_MESSAGE(SnapshotStatsEntry, MD_SNAPSHOT_STATS_ENTRY_FIELDS)
+MD_DEFINE_MESSAGE(Heartbeat, MD_HEARTBEAT_FIELDS)
+
+using IndexSnapshot = Grouped<SnapshotHead, IndexSnapshotEntry,
+                              &SnapshotHead::no_md_entries>;
+using SecurityStatus = Grouped<SecurityStatusHead, SecuritySwitch,
+                               &SecurityStatusHead::no_switch>;
+using SnapshotStats = Grouped<SnapshotStatsHead, SnapshotStatsEntry,
+                              &SnapshotStatsHead::no_md_stream_id>;
+} // namespace schema
+} // namespace md
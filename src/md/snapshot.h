@@ -2,10 +2,6 @@
 
 #include "common.h"
 
-#include <cassert>
-#include <string>
-#include <vector>
-
 namespace md {
 struct __attribute__((packed)) SnapshotHeader {
   int64_t be_orig_time;
@@ -22,6 +18,8 @@ struct __attribute__((packed)) SnapshotHeader {
 
   int64_t orig_time() const { return be64toh(be_orig_time); }
 
+  uint16_t channel_no() const { return be16toh(be_channel_no); }
+
   int64_t total_trade_num() const { return be64toh(be_total_trade_num); }
 
   int64_t total_trade_volume() const { return be64toh(be_total_trade_volume); }
@@ -63,33 +61,4 @@ struct BookLevel {
   int64_t price{0};
   int64_t quantity{0};
 };
-
-class SnapshotWrapper {
-public:
-  explicit SnapshotWrapper(const u_char *raw_data);
-
-  void init_md_entries();
-
-  const BookLevel &get_bid_level(int n) const { return bid_book_[n]; }
-
-  const BookLevel &get_ask_level(int n) const { return ask_book_[n]; }
-
-  const int depth() const { return bid_book_.size() - 1; }
-
-  std::string security_id;
-  int64_t orig_time;
-  int64_t total_trade_num{0};
-  int64_t total_trade_volume{0};
-  int64_t total_trade_value{0};
-  int64_t latest_trade_price{0};
-  int64_t open_price{0};
-
-private:
-  std::vector<BookLevel> bid_book_;
-  std::vector<BookLevel> ask_book_;
-
-  const SnapshotHeader *header_{nullptr};
-  // return how many bytes parsed
-  int parse_extended_fields(const MarketDataEntry &);
-};
 } // namespace md
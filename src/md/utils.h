@@ -7,13 +7,15 @@
 #include <string>
 
 namespace md {
-inline void print_hex_array(const u_char *buf, size_t len) {
-  for (uint32_t i = 0; i < len; i++) {
-    std::cout << std::setfill('0') << std::setw(2) << std::hex
-              << (0xff & buf[i]) << " ";
+inline void print_hex_array(const u_char *buf, size_t len,
+                            std::ostream &os = std::cout) {
+  static const char digits[] = "0123456789abcdef";
+  std::string line(len * 3, ' ');
+  for (size_t i = 0; i < len; i++) {
+    line[i * 3] = digits[buf[i] >> 4];
+    line[i * 3 + 1] = digits[buf[i] & 0xf];
   }
-  std::cout << '\n';
-  std::cout << std::resetiosflags(std::ios_base::basefield);
+  os << line << '\n';
 }
 
 inline std::string bytes_to_str(const char bytes[], int len) {
@@ -34,6 +36,15 @@ inline std::string bytes_to_str(const char bytes[], int len) {
   return std::string(buffer);
 }
 
+// numeric security id padded with spaces, e.g. "000001  "
+inline uint32_t parse_security_id(const char bytes[]) {
+  uint32_t id = 0;
+  for (int i = 0; i < 8 && bytes[i] >= '0' && bytes[i] <= '9'; i++) {
+    id = id * 10 + (bytes[i] - '0');
+  }
+  return id;
+}
+
 inline std::string timestamp_to_string(int64_t ts) {
   int millis = ts % 1000;
   ts /= 1000;
@@ -49,4 +60,47 @@ inline std::string timestamp_to_string(int64_t ts) {
      << millis;
   return ss.str();
 }
+
+// exchange time is YYYYMMDDHHMMSSsss, returns milliseconds since midnight
+inline int64_t exchange_time_to_millis(int64_t ts) {
+  int64_t millis = ts % 1000;
+  ts /= 1000;
+  int64_t seconds = ts % 100;
+  ts /= 100;
+  int64_t minutes = ts % 100;
+  ts /= 100;
+  int64_t hours = ts % 100;
+  return ((hours * 60 + minutes) * 60 + seconds) * 1000 + millis;
+}
+
+// exchange time is local time of the exchange, utc_offset_seconds ahead
+// of UTC, returns micro seconds since epoch like pcap timestamps
+inline int64_t exchange_time_to_epoch_micros(int64_t ts,
+                                             int64_t utc_offset_seconds) {
+  int64_t date = ts / 1000000000;
+  int64_t year = date / 10000;
+  int64_t month = date / 100 % 100;
+  int64_t day = date % 100;
+  // days since 1970-01-01 of a proleptic gregorian date, see
+  // http://howardhinnant.github.io/date_algorithms.html#days_from_civil
+  year -= month <= 2 ? 1 : 0;
+  int64_t era = (year >= 0 ? year : year - 399) / 400;
+  int64_t year_of_era = year - era * 400;
+  int64_t day_of_year =
+      (153 * (month + (month > 2 ? -3 : 9)) + 2) / 5 + day - 1;
+  int64_t day_of_era = year_of_era * 365 + year_of_era / 4 -
+                       year_of_era / 100 + day_of_year;
+  int64_t days = era * 146097 + day_of_era - 719468;
+  int64_t millis = days * 86400000 + exchange_time_to_millis(ts) -
+                   utc_offset_seconds * 1000;
+  return millis * 1000;
+}
+
+// inverse of exchange_time_to_millis without the date, i.e. HHMMSSsss
+inline int64_t millis_to_exchange_time(int64_t millis) {
+  int64_t seconds = millis / 1000;
+  return (seconds / 3600 * 10000 + seconds / 60 % 60 * 100 + seconds % 60) *
+             1000 +
+         millis % 1000;
+}
 } // namespace md
@@ -0,0 +1,130 @@
+#pragma once
+
+#include "udp_packet_processor.h"
+
+#include <cstring>
+#include <stdexcept>
+
+// parses ethernet, up to two 802.1Q/802.1ad tags, ipv4 with options and udp
+// headers of a frame in one pass and matches the addresses against the feeds,
+// replacing a "net a or net b" bpf filter and a second parse
+class PacketClassifier {
+public:
+  static const int MAX_FEEDS = 8;
+
+  // results besides a feed index
+  static const int IGNORED = -2;   // not udp over ipv4, or no feed involved
+  static const int UNMATCHED = -1; // udp to a feed net, from none of them
+
+  void add_feed(const in_addr &net, const in_addr &netmask) {
+    if (feed_count_ == MAX_FEEDS) {
+      throw std::invalid_argument("too many feeds to classify");
+    }
+    masks_[feed_count_] = netmask.s_addr;
+    nets_[feed_count_] = net.s_addr & netmask.s_addr;
+    feed_count_ += 1;
+  }
+
+  int feed_count() const { return feed_count_; }
+
+  // index of the first feed whose net holds the source address, packet is
+  // filled for it and for UNMATCHED, bytes beyond caplen are never read
+  int classify(const u_char *frame, uint32_t caplen,
+               UdpPacket &packet) const {
+    // untagged ethernet with the shortest ip and udp headers, which also
+    // covers the fixed ip fields read behind two tags
+    if (caplen < 14 + 28) {
+      return IGNORED;
+    }
+    uint16_t ether_type = load16(frame + 12);
+    // nearly all feed traffic is plain ipv4 without options, its offsets
+    // are constant once inlined
+    if (ether_type == 0x0800 && frame[14] == 0x45) {
+      return classify_udp(frame, caplen, 14, 20, packet);
+    }
+
+    // a port is either tagged or not, so these branches predict well and
+    // keep the ip loads off a data dependent offset
+    uint32_t offset = 12;
+    if (is_vlan(ether_type)) {
+      offset += 4;
+      ether_type = load16(frame + offset);
+      if (is_vlan(ether_type)) {
+        offset += 4;
+        ether_type = load16(frame + offset);
+      }
+    }
+    offset += 2;
+
+    const u_char *ip = frame + offset;
+    uint32_t ip_length = (ip[0] & 0x0f) * 4;
+    // ipv4 and header length are folded into one branch
+    bool ipv4 = (ether_type == 0x0800) & ((ip[0] >> 4) == 4) &
+                (ip_length >= 20);
+    if (!ipv4) {
+      return IGNORED;
+    }
+    return classify_udp(frame, caplen, offset, ip_length, packet);
+  }
+
+private:
+  // the rest of classify() behind an ipv4 header at ip_offset
+  int classify_udp(const u_char *frame, uint32_t caplen, uint32_t ip_offset,
+                   uint32_t ip_length, UdpPacket &packet) const {
+    const u_char *ip = frame + ip_offset;
+    uint32_t udp_offset = ip_offset + ip_length;
+    // udp, first fragment and captured udp header are folded into one branch
+    bool udp = (ip[9] == IPPROTO_UDP) & ((load16(ip + 6) & 0x1fff) == 0) &
+               (caplen >= udp_offset + 8);
+    if (!udp) {
+      return IGNORED;
+    }
+
+    uint32_t source, dest;
+    memcpy(&source, ip + 12, sizeof(source));
+    memcpy(&dest, ip + 16, sizeof(dest));
+    int feed = find(source);
+    if (feed == feed_count_) {
+      // the destination only tells UNMATCHED from IGNORED
+      if (find(dest) == feed_count_) {
+        return IGNORED;
+      }
+      feed = UNMATCHED;
+    }
+
+    const u_char *udp_header = frame + udp_offset;
+    packet.payload = udp_header + 8;
+    packet.captured = caplen - udp_offset - 8;
+    packet.source_port = load16(udp_header);
+    packet.dest_port = load16(udp_header + 2);
+    packet.length = load16(udp_header + 4);
+    packet.source.s_addr = source;
+    return feed;
+  }
+
+  // index of the first feed holding the address, feed_count_ for none.
+  // feeds arrive in runs, so the exit branch predicts well
+  int find(uint32_t address) const {
+    int feed = 0;
+    while (feed < feed_count_ && (address & masks_[feed]) != nets_[feed]) {
+      ++feed;
+    }
+    return feed;
+  }
+
+  static uint16_t load16(const u_char *p) {
+    uint16_t value;
+    memcpy(&value, p, sizeof(value));
+    return ntohs(value);
+  }
+
+  // 802.1Q or 802.1ad
+  static bool is_vlan(uint16_t ether_type) {
+    return (ether_type == 0x8100) | (ether_type == 0x88a8);
+  }
+
+  // nets are stored masked
+  uint32_t masks_[MAX_FEEDS] = {};
+  uint32_t nets_[MAX_FEEDS] = {};
+  int feed_count_{0};
+};
@@ -0,0 +1,77 @@
+#pragma once
+
+#include "udp_packet_processor.h"
+
+#include <atomic>
+#include <cstring>
+#include <memory>
+
+// bounded lock-free queue of udp packet copies, one producer and one consumer
+// packets are copied straight into a slot, nothing is allocated after
+// construction
+class PacketQueue {
+public:
+  struct Slot {
+    // payload points to data
+    UdpPacket packet;
+    // set by the producer, e.g. the feed a packet comes from
+    uint32_t tag;
+    // longer payloads are truncated, market data fits an ethernet frame
+    u_char data[1472];
+  };
+
+  // capacity shall be power of 2
+  explicit PacketQueue(size_t capacity)
+      : slots_(new Slot[capacity]), mask_(capacity - 1) {}
+
+  // returns false when the queue is full
+  bool push(const UdpPacket &packet, uint32_t tag) {
+    size_t tail = tail_.load(std::memory_order_relaxed);
+    if (tail - head_cache_ > mask_) {
+      head_cache_ = head_.load(std::memory_order_acquire);
+      if (tail - head_cache_ > mask_) {
+        return false;
+      }
+    }
+    Slot &slot = slots_[tail & mask_];
+    slot.packet = packet;
+    if (slot.packet.captured > sizeof(slot.data)) {
+      slot.packet.captured = sizeof(slot.data);
+    }
+    std::memcpy(slot.data, packet.payload, slot.packet.captured);
+    slot.packet.payload = slot.data;
+    slot.tag = tag;
+    tail_.store(tail + 1, std::memory_order_release);
+    return true;
+  }
+
+  // returns nullptr when the queue is empty, the slot is valid until pop()
+  const Slot *front() {
+    size_t head = head_.load(std::memory_order_relaxed);
+    if (head == tail_cache_) {
+      tail_cache_ = tail_.load(std::memory_order_acquire);
+      if (head == tail_cache_) {
+        return nullptr;
+      }
+    }
+    return &slots_[head & mask_];
+  }
+
+  void pop() {
+    head_.store(head_.load(std::memory_order_relaxed) + 1,
+                std::memory_order_release);
+  }
+
+private:
+  // padded rather than aligned, the queue is allocated with plain new
+  std::unique_ptr<Slot[]> slots_;
+  const size_t mask_;
+  char padding0_[64];
+  // consumer side
+  std::atomic<size_t> head_{0};
+  size_t tail_cache_{0};
+  char padding1_[64];
+  // producer side
+  std::atomic<size_t> tail_{0};
+  size_t head_cache_{0};
+};
@@ -1,53 +1,130 @@
 #include "pcap_reader.h"
+#include "../diag/logger.h"
 
-// network
-#include <iostream>
-#include <net/if.h>
-#include <netinet/if_ether.h>
-#include <netinet/in.h>
-#include <netinet/ip.h>
-#include <netinet/udp.h>
+#include <cstring>
+
+namespace {
+
+// libpcap's savefile magic numbers, micro and nano second timestamps
+constexpr uint32_t MAGIC_MICROS = 0xa1b2c3d4;
+constexpr uint32_t MAGIC_NANOS = 0xa1b23c4d;
+
+constexpr size_t RECORD_HEADER_SIZE = 16;
+// libpcap refuses larger records as corrupt
+constexpr uint32_t MAX_CAPLEN = 262144;
+constexpr size_t BLOCK_SIZE = 1 << 20;
+
+} // namespace
 
 int PcapReader::set_filter(const std::string &filter_str) {
   bpf_program filter;
-  int result =
-      pcap_compile(file_, &filter, filter_str.c_str(), 0 /*no optimize*/,
-                   PCAP_NETMASK_UNKNOWN /*capture any interface*/);
+  int result = pcap_compile(file_, &filter, filter_str.c_str(), 1 /*optimize*/,
+                            PCAP_NETMASK_UNKNOWN /*capture any interface*/);
   if (result != 0) {
     return result;
   }
-  // apply filter
-  return pcap_setfilter(file_, &filter);
+  // apply filter, pcap keeps its own copy
+  result = pcap_setfilter(file_, &filter);
+  pcap_freecode(&filter);
+  if (result == 0) {
+    // only libpcap's own reads are filtered
+    block_reads_ = false;
+  }
+  return result;
 }
 
-int PcapReader::read_pcap_packet(const u_char *packet) {
-  auto *ethernet_header = reinterpret_cast<const ether_header *>(packet);
-  if (ntohs(ethernet_header->ether_type) != ETHERTYPE_IP) {
-    // ignore non ip packet
-    return 0;
+void PcapReader::read_magic(const std::string &filename) {
+  FILE *file = fopen(filename.c_str(), "rb");
+  if (file == nullptr) {
+    return;
+  }
+  uint32_t magic = 0;
+  size_t read = fread(&magic, sizeof(magic), 1, file);
+  fclose(file);
+  if (read != 1) {
+    return;
+  }
+  swapped_ = magic == __builtin_bswap32(MAGIC_MICROS) ||
+             magic == __builtin_bswap32(MAGIC_NANOS);
+  if (swapped_) {
+    magic = __builtin_bswap32(magic);
+  }
+  nano_ = magic == MAGIC_NANOS;
+  block_reads_ = magic == MAGIC_MICROS || magic == MAGIC_NANOS;
+}
+
+const u_char *PcapReader::next_in_block() {
+  if (block_end_ - block_begin_ < RECORD_HEADER_SIZE) {
+    record_size_ = RECORD_HEADER_SIZE;
+    return nullptr;
+  }
+  uint32_t record[4];
+  memcpy(record, block_.data() + block_begin_, sizeof(record));
+  if (swapped_) {
+    for (uint32_t &field : record) {
+      field = __builtin_bswap32(field);
+    }
+  }
+  record_size_ = RECORD_HEADER_SIZE + record[2];
+  if (record[2] > MAX_CAPLEN || block_end_ - block_begin_ < record_size_) {
+    return nullptr;
   }
+  header_.ts.tv_sec = record[0];
+  header_.ts.tv_usec = nano_ ? record[1] / 1000 : record[1];
+  header_.caplen = record[2];
+  header_.len = record[3];
+  const u_char *packet = block_.data() + block_begin_ + RECORD_HEADER_SIZE;
+  block_begin_ += record_size_;
+  return packet;
+}
 
-  auto *ip_header = reinterpret_cast<const ip *>(packet + sizeof(ether_header));
-  if (ip_header->ip_p != IPPROTO_UDP) {
-    // ignore non udp packet
-    return 0;
+bool PcapReader::refill_block() {
+  if (record_size_ > RECORD_HEADER_SIZE + MAX_CAPLEN) {
+    // corrupt caplen, libpcap would stop here too
+    return false;
+  }
+  size_t left = block_end_ - block_begin_;
+  memmove(block_.data(), block_.data() + block_begin_, left);
+  block_begin_ = 0;
+  block_end_ = left;
+  if (block_.size() < BLOCK_SIZE) {
+    block_.resize(BLOCK_SIZE);
   }
+  size_t read = fread(block_.data() + block_end_, 1,
+                      block_.size() - block_end_, pcap_file(file_));
+  block_end_ += read;
+  return read > 0;
+}
 
+int PcapReader::parse_packet(const u_char *packet, UdpPacket &udp_packet) {
+  int feed = classifier_.classify(packet, header_.caplen, udp_packet);
+  if (feed == PacketClassifier::IGNORED) {
+    // not udp, or to and from none of the nets
+    return -1;
+  }
+
+  // counts what a "net a or net b" filter lets through
   udp_packet_index_ += 1;
 
-  for (auto &processor : processors_) {
-    if (processor->match(ip_header->ip_src)) {
-      const u_char *udp_header = packet + sizeof(ether_header) + sizeof(ip);
-      processor->process(*reinterpret_cast<const udphdr *>(udp_header),
-                         udp_header + sizeof(udphdr));
-      return 1;
-    }
+  if (feed == PacketClassifier::UNMATCHED) {
+    // only sent to one of the nets
+    diag::log(diag::Event::UnmatchedPacket, udp_packet_index_,
+              udp_packet.source.s_addr);
+    return -1;
+  }
+  udp_packet.pcap_ts = get_pcap_timestamp(header_);
+  udp_packet.index = udp_packet_index_;
+  return feed;
+}
+
+int PcapReader::read_pcap_packet(const u_char *packet) {
+  UdpPacket udp_packet;
+  int processor = parse_packet(packet, udp_packet);
+  if (processor < 0) {
+    return 0;
   }
-  // does not match any processor
-  std::cout << "udp packet " << udp_packet_index_ << " from "
-            << inet_ntoa(ip_header->ip_src)
-            << " does not match any of the processor\n";
-  return 0;
+  processors_[processor]->process(udp_packet);
+  return 1;
 }
 
 uint64_t PcapReader::process(long stop_epoch_seconds) {
@@ -61,3 +138,60 @@ uint64_t PcapReader::process(long stop_epoch_seconds) {
   }
   return processed_count;
 }
+
+bool PcapReader::process_next(long stop_epoch_seconds) {
+  const u_char *next_packet = pcap_next(file_, &header_);
+  if (next_packet == nullptr || header_.ts.tv_sec > stop_epoch_seconds) {
+    return false;
+  }
+  read_pcap_packet(next_packet);
+  return true;
+}
+
+uint64_t PcapReader::process_batched(size_t batch_size,
+                                     long stop_epoch_seconds) {
+  assert(batch_size > 0);
+  if (!block_reads_) {
+    return process(stop_epoch_seconds);
+  }
+  uint64_t processed_count = 0;
+  bool more = true;
+  while (more) {
+    owners_.clear();
+    batch_.clear();
+    while (batch_.size() < batch_size) {
+      const u_char *next_packet = next_in_block();
+      if (next_packet == nullptr) {
+        // refilling moves the block, hand out what points into it first
+        if (!batch_.empty()) {
+          break;
+        }
+        if (!refill_block()) {
+          more = false;
+          break;
+        }
+        continue;
+      }
+      if (header_.ts.tv_sec > stop_epoch_seconds) {
+        more = false;
+        break;
+      }
+      UdpPacket packet;
+      int owner = parse_packet(next_packet, packet);
+      if (owner < 0) {
+        continue;
+      }
+      owners_.push_back(owner);
+      batch_.push_back(packet);
+    }
+
+    for (size_t begin = 0, end = 0; begin < batch_.size(); begin = end) {
+      while (end < batch_.size() && owners_[end] == owners_[begin]) {
+        ++end;
+      }
+      processors_[owners_[begin]]->process_batch(&batch_[begin], end - begin);
+    }
+    processed_count += batch_.size();
+  }
+  return processed_count;
+}
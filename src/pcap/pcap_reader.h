@@ -1,11 +1,14 @@
 #pragma once
 
+#include "packet_classifier.h"
 #include "udp_packet_processor.h"
 
 #include <cassert>
 #include <limits>
 #include <pcap.h>
+#include <cstdio>
 #include <stdexcept>
+#include <string>
 #include <vector>
 /*
 struct timeval
@@ -26,13 +29,30 @@ public:
     if (file_ == nullptr) {
       throw std::invalid_argument("invalid pcap file: " + filename);
     }
+    read_magic(filename);
+  }
+
+  // takes ownership of the stream, e.g. one fed by io::UringReadAhead
+  PcapReader(FILE *stream, std::string name) {
+    file_ = stream == nullptr ? nullptr : pcap_fopen_offline(stream, errbuf_);
+    if (file_ == nullptr) {
+      if (stream != nullptr) {
+        fclose(stream);
+      }
+      throw std::invalid_argument("invalid pcap file: " + name);
+    }
+    read_magic(name);
   }
 
   ~PcapReader() { pcap_close(file_); }
 
+  // the nets of the processors are matched natively, a bpf filter is only
+  // needed to narrow packets down further
   int set_filter(const std::string &filter_str);
 
+  // packets go to the first processor whose net holds their source
   void add_processor(UdpPacketProcessor *processor) {
+    classifier_.add_feed(processor->net(), processor->netmask());
     processors_.push_back(processor);
   }
 
@@ -42,16 +62,60 @@ public:
   // loop until file ends, return how many packets parsed
   uint64_t process(long stop_epoch_seconds = std::numeric_limits<long>::max());
 
+  // read and dispatch a single packet, for callers pulling results as they
+  // go. returns false once the file ends
+  bool process_next(long stop_epoch_seconds = std::numeric_limits<long>::max());
+
+  // same as process(), but parses up to batch_size packets ahead and hands
+  // each run of consecutive packets of one processor to process_batch()
+  // capture order is kept across processors, arbitration relies on it
+  // classic pcap files are read in blocks here and payloads point into the
+  // block, pcapng or filtered files fall back to process()
+  uint64_t
+  process_batched(size_t batch_size,
+                  long stop_epoch_seconds = std::numeric_limits<long>::max());
+
   const pcap_pkthdr &pcap_header() const { return header_; }
 
   uint64_t udp_packet_index() const { return udp_packet_index_; }
 
+  // continue the numbering of a previous file of the same capture
+  void set_udp_packet_index(uint64_t index) { udp_packet_index_ = index; }
+
 private:
+  // fill the descriptor and return the index of the matching processor,
+  // -1 for packets no processor takes
+  int parse_packet(const u_char *packet, UdpPacket &udp_packet);
+
+  // libpcap hides the timestamp unit of the file, so the magic is read
+  // again by name. leaves block_reads_ unset for anything but classic pcap
+  void read_magic(const std::string &filename);
+
+  // next record of the block, nullptr once no whole record is left in it
+  const u_char *next_in_block();
+
+  // move the partial record to the front and read more behind it, false
+  // once the file ends
+  bool refill_block();
+
   pcap_t *file_;
   pcap_pkthdr header_;
-  uint64_t udp_packet_index_;
+  uint64_t udp_packet_index_{0};
   char errbuf_[PCAP_ERRBUF_SIZE];
 
   // one procesor for one md feed
   std::vector<UdpPacketProcessor *> processors_;
+  PacketClassifier classifier_;
+
+  // pcap reuses its buffer on every read, so batches are read in blocks
+  // past libpcap, which has only consumed the file header by then
+  bool block_reads_{false};
+  bool swapped_{false};
+  bool nano_{false};
+  std::vector<u_char> block_;
+  size_t block_begin_{0};
+  size_t block_end_{0};
+  size_t record_size_{0};
+  std::vector<int> owners_;
+  std::vector<UdpPacket> batch_;
 };
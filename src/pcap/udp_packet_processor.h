@@ -2,6 +2,8 @@
 #include <arpa/inet.h>
 #include <netinet/in.h>
 #include <netinet/udp.h>
+#include <cstddef>
+#include <cstdint>
 #include <stdexcept>
 /*
 struct in_addr {
@@ -9,6 +11,19 @@ struct in_addr {
 };
 */
 
+// headers of one udp packet, parsed once by the reader
+// ports and length are in host byte order
+struct UdpPacket {
+  const u_char *payload;
+  uint32_t captured; // payload bytes present in the capture
+  uint16_t length;   // udp length, including the 8 byte header
+  uint16_t source_port;
+  uint16_t dest_port;
+  in_addr source;
+  uint64_t pcap_ts; // micro seconds since epoch
+  uint64_t index;   // udp packet index in the capture, starts from 1
+};
+
 class UdpPacketProcessor {
 public:
   explicit UdpPacketProcessor(std::string net_str, std::string netmask_str) {
@@ -27,7 +42,17 @@ public:
     return (netmask_.s_addr & ip.s_addr) == (netmask_.s_addr & net_.s_addr);
   }
 
-  virtual void process(const udphdr &udp_header, const u_char *udp_payload) {}
+  const in_addr &net() const { return net_; }
+  const in_addr &netmask() const { return netmask_; }
+
+  virtual void process(const UdpPacket &packet) {}
+
+  // packets of this processor in capture order, only valid during the call
+  virtual void process_batch(const UdpPacket *packets, size_t count) {
+    for (size_t i = 0; i < count; ++i) {
+      process(packets[i]);
+    }
+  }
 
 private:
   in_addr net_;
@@ -0,0 +1,273 @@
+#include "event_stream.h"
+
+#include "../md/utils.h"
+
+#include <stdexcept>
+
+using namespace python;
+
+namespace {
+template <typename T>
+void add_column(ColumnBatch &batch, std::string name, char format,
+                size_t rows) {
+  Column column{std::move(name), format, sizeof(T), {}};
+  column.data.reserve(rows * sizeof(T));
+  batch.columns.push_back(std::move(column));
+}
+
+// capacity is reserved up front, so this stays a copy
+template <typename T> inline void put(Column &column, T value) {
+  size_t size = column.data.size();
+  column.data.resize(size + sizeof(T));
+  std::memcpy(&column.data[size], &value, sizeof(T));
+}
+
+// leading columns shared by all types
+void add_arrival_columns(ColumnBatch &batch, size_t rows) {
+  add_column<uint64_t>(batch, "pcap_ts", 'Q', rows);
+  add_column<uint64_t>(batch, "pcap_seq", 'Q', rows);
+  add_column<uint32_t>(batch, "security_id", 'I', rows);
+  add_column<uint16_t>(batch, "channel_no", 'H', rows);
+}
+} // namespace
+
+EventStream::EventStream(StreamOptions options) : options_(options) {
+  if (options_.files.empty()) {
+    throw std::invalid_argument("no pcap file given");
+  }
+  if (options_.nets.empty() ||
+      options_.nets.size() > md::FragmentMerger::MAX_FEEDS) {
+    throw std::invalid_argument("one or two feed nets are supported");
+  }
+  if (options_.batch_rows == 0) {
+    throw std::invalid_argument("batch_rows must be positive");
+  }
+  if (options_.depth < 0 || options_.depth > md::SnapshotEvent::DEPTH) {
+    throw std::invalid_argument("depth must be within 0 and " +
+                                std::to_string(md::SnapshotEvent::DEPTH));
+  }
+  if (options_.prune_warmup > 0 && !options_.stocks.empty()) {
+    pruner_.reset(
+        new md::ChannelPruner(options_.stocks, options_.prune_warmup));
+  }
+  // feeds are numbered in the order of the nets
+  for (uint32_t feed = 0; feed < options_.nets.size(); ++feed) {
+    auto handler = [this](const u_char *data, uint32_t len,
+                          const UdpPacket &packet) {
+      on_message(data, len, packet);
+    };
+    processors_.emplace_back(new md::MdPreprocessor(
+        options_.nets[feed], options_.netmask, handler));
+    processors_.back()->set_merger(&merger_, feed);
+    if (pruner_) {
+      processors_.back()->set_pruner(pruner_.get());
+    }
+  }
+}
+
+std::unique_ptr<ColumnBatch> EventStream::next() {
+  while (ready_.empty()) {
+    if (!reader_) {
+      if (next_file_ == options_.files.size()) {
+        break;
+      }
+      open_next_file();
+    }
+    if (reader_->process_next()) {
+      packets_ += 1;
+      continue;
+    }
+    seq_base_ += reader_->udp_packet_index();
+    reader_.reset();
+    if (next_file_ == options_.files.size()) {
+      seal(md::EventType::Order, false);
+      seal(md::EventType::Trade, false);
+      seal(md::EventType::Snapshot, false);
+    }
+  }
+  if (ready_.empty()) {
+    return nullptr;
+  }
+  auto batch = std::move(ready_.front());
+  ready_.pop_front();
+  return batch;
+}
+
+void EventStream::open_next_file() {
+  reader_.reset(new PcapReader(options_.files[next_file_++]));
+  for (auto &processor : processors_) {
+    reader_->add_processor(processor.get());
+  }
+}
+
+bool EventStream::wanted(uint32_t security_id, int64_t exchange_time) const {
+  if (!options_.stocks.empty() &&
+      options_.stocks.find(security_id) == options_.stocks.end()) {
+    return false;
+  }
+  int64_t millis = md::exchange_time_to_millis(exchange_time);
+  return millis >= options_.start_millis && millis <= options_.end_millis;
+}
+
+void EventStream::on_message(const u_char *data, uint32_t len,
+                             const UdpPacket &packet) {
+  decoder_.decode(data, len, batch_);
+  uint64_t pcap_ts = packet.pcap_ts;
+  uint64_t pcap_seq = seq_base_ + packet.index;
+
+  // arbitrated before filtering, the other feed may carry the same events
+  for (const auto &entry : batch_.entries) {
+    switch (entry.type) {
+    case md::EventType::Order: {
+      const auto &order = batch_.orders[entry.index];
+      if (arbitrator_.record_order_or_trade(order.channel_no,
+                                            order.appl_seq_num) &&
+          options_.orders &&
+          wanted(order.security_id, order.transaction_time)) {
+        append(order, pcap_ts, pcap_seq);
+      }
+      break;
+    }
+    case md::EventType::Trade: {
+      const auto &trade = batch_.trades[entry.index];
+      if (arbitrator_.record_order_or_trade(trade.channel_no,
+                                            trade.appl_seq_num) &&
+          options_.trades &&
+          wanted(trade.security_id, trade.transaction_time)) {
+        append(trade, pcap_ts, pcap_seq);
+      }
+      break;
+    }
+    case md::EventType::Snapshot: {
+      const auto &snapshot = batch_.snapshots[entry.index];
+      if (arbitrator_.record_snapshot(snapshot.security_id,
+                                      snapshot.orig_time) &&
+          options_.snapshots &&
+          wanted(snapshot.security_id, snapshot.orig_time)) {
+        append(snapshot, pcap_ts, pcap_seq);
+      }
+      break;
+    }
+    default:
+      break;
+    }
+  }
+}
+
+ColumnBatch &EventStream::building(md::EventType kind) {
+  auto &batch = building_[static_cast<int>(kind)];
+  if (batch) {
+    return *batch;
+  }
+  size_t rows = options_.batch_rows;
+  batch.reset(new ColumnBatch);
+  batch->kind = kind;
+  add_arrival_columns(*batch, rows);
+  switch (kind) {
+  case md::EventType::Order:
+    add_column<uint64_t>(*batch, "appl_seq_num", 'Q', rows);
+    add_column<int64_t>(*batch, "transaction_time", 'q', rows);
+    add_column<int64_t>(*batch, "price", 'q', rows);
+    add_column<int64_t>(*batch, "quantity", 'q', rows);
+    add_column<char>(*batch, "side", 'c', rows);
+    add_column<char>(*batch, "order_type", 'c', rows);
+    break;
+  case md::EventType::Trade:
+    add_column<uint64_t>(*batch, "appl_seq_num", 'Q', rows);
+    add_column<int64_t>(*batch, "transaction_time", 'q', rows);
+    add_column<int64_t>(*batch, "price", 'q', rows);
+    add_column<int64_t>(*batch, "quantity", 'q', rows);
+    add_column<uint64_t>(*batch, "bid_appl_seq_num", 'Q', rows);
+    add_column<uint64_t>(*batch, "offer_appl_seq_num", 'Q', rows);
+    add_column<char>(*batch, "execute_type", 'c', rows);
+    break;
+  default:
+    add_column<int64_t>(*batch, "orig_time", 'q', rows);
+    add_column<int64_t>(*batch, "total_trade_num", 'q', rows);
+    add_column<int64_t>(*batch, "total_trade_volume", 'q', rows);
+    add_column<int64_t>(*batch, "total_trade_value", 'q', rows);
+    add_column<int64_t>(*batch, "latest_trade_price", 'q', rows);
+    add_column<int64_t>(*batch, "open_price", 'q', rows);
+    // bid_price_1 is the best bid
+    for (const char *side : {"bid", "ask"}) {
+      for (int level = 1; level <= options_.depth; ++level) {
+        std::string suffix = "_" + std::to_string(level);
+        add_column<int64_t>(*batch, side + ("_price" + suffix), 'q', rows);
+        add_column<int64_t>(*batch, side + ("_quantity" + suffix), 'q', rows);
+      }
+    }
+    break;
+  }
+  return *batch;
+}
+
+void EventStream::seal(md::EventType kind, bool full_only) {
+  auto &batch = building_[static_cast<int>(kind)];
+  if (!batch || batch->rows == 0 ||
+      (full_only && batch->rows < options_.batch_rows)) {
+    return;
+  }
+  ready_.push_back(std::move(batch));
+}
+
+void EventStream::append(const md::OrderEvent &order, uint64_t pcap_ts,
+                         uint64_t pcap_seq) {
+  auto &batch = building(md::EventType::Order);
+  auto *column = batch.columns.data();
+  put(column[0], pcap_ts);
+  put(column[1], pcap_seq);
+  put(column[2], order.security_id);
+  put(column[3], order.channel_no);
+  put(column[4], order.appl_seq_num);
+  put(column[5], order.transaction_time);
+  put(column[6], order.price);
+  put(column[7], order.quantity);
+  put(column[8], order.side);
+  put(column[9], order.order_type);
+  batch.rows += 1;
+  seal(md::EventType::Order, true);
+}
+
+void EventStream::append(const md::TradeEvent &trade, uint64_t pcap_ts,
+                         uint64_t pcap_seq) {
+  auto &batch = building(md::EventType::Trade);
+  auto *column = batch.columns.data();
+  put(column[0], pcap_ts);
+  put(column[1], pcap_seq);
+  put(column[2], trade.security_id);
+  put(column[3], trade.channel_no);
+  put(column[4], trade.appl_seq_num);
+  put(column[5], trade.transaction_time);
+  put(column[6], trade.price);
+  put(column[7], trade.quantity);
+  put(column[8], trade.bid_appl_seq_num);
+  put(column[9], trade.offer_appl_seq_num);
+  put(column[10], trade.execute_type);
+  batch.rows += 1;
+  seal(md::EventType::Trade, true);
+}
+
+void EventStream::append(const md::SnapshotEvent &snapshot, uint64_t pcap_ts,
+                         uint64_t pcap_seq) {
+  auto &batch = building(md::EventType::Snapshot);
+  auto *column = batch.columns.data();
+  put(column[0], pcap_ts);
+  put(column[1], pcap_seq);
+  put(column[2], snapshot.security_id);
+  put(column[3], snapshot.channel_no);
+  put(column[4], snapshot.orig_time);
+  put(column[5], snapshot.total_trade_num);
+  put(column[6], snapshot.total_trade_volume);
+  put(column[7], snapshot.total_trade_value);
+  put(column[8], snapshot.latest_trade_price);
+  put(column[9], snapshot.open_price);
+  column += 10;
+  for (const auto *levels : {snapshot.bids, snapshot.asks}) {
+    for (int level = 0; level < options_.depth; ++level) {
+      put(*column++, levels[level].price);
+      put(*column++, levels[level].quantity);
+    }
+  }
+  batch.rows += 1;
+  seal(md::EventType::Snapshot, true);
+}
@@ -0,0 +1,113 @@
+#pragma once
+
+#include "../md/arbitrator.h"
+#include "../md/channel_pruner.h"
+#include "../md/decoder.h"
+#include "../md/fragment_merger.h"
+#include "../md/preprocessor.h"
+#include "../pcap/pcap_reader.h"
+
+#include <cstdint>
+#include <cstring>
+#include <deque>
+#include <limits>
+#include <memory>
+#include <set>
+#include <string>
+#include <vector>
+
+namespace python {
+// values of one field for all rows of a batch, packed back to back
+struct Column {
+  std::string name;
+  // struct module format of one value: q Q I H c
+  char format;
+  uint32_t itemsize;
+  std::vector<char> data;
+};
+
+// rows of one event type, column by column
+struct ColumnBatch {
+  md::EventType kind;
+  size_t rows{0};
+  std::vector<Column> columns;
+};
+
+struct StreamOptions {
+  // read one after the other, arbitration carries over
+  std::vector<std::string> files;
+  // securities to keep, all if empty
+  std::set<uint32_t> stocks;
+  // exchange time of day in millis, inclusive
+  int64_t start_millis{0};
+  int64_t end_millis{std::numeric_limits<int64_t>::max()};
+  bool orders{true};
+  bool trades{true};
+  bool snapshots{true};
+  size_t batch_rows{65536};
+  // book levels of snapshots, up to SnapshotEvent::DEPTH
+  int depth{5};
+  // skip channels without any of the stocks, as with -p
+  uint32_t prune_warmup{0};
+  std::vector<std::string> nets{"172.27.1.0", "172.27.129.0"};
+  std::string netmask{"255.255.255.0"};
+};
+
+// decodes captures into column batches, the pipeline of main without
+// the outputs
+//
+// messages of both feeds are reassembled, decoded and arbitrated as for the
+// csv outputs, then filtered by security and exchange time before any row
+// is written. a batch is handed out as soon as batch_rows rows of its type
+// are in, the remainders come last, so batches of different types overlap
+// in time
+class EventStream {
+public:
+  explicit EventStream(StreamOptions options);
+
+  // the processors call back into it
+  EventStream(const EventStream &) = delete;
+  EventStream &operator=(const EventStream &) = delete;
+
+  // next batch, nullptr once all files are read
+  std::unique_ptr<ColumnBatch> next();
+
+  // packets read from all files so far
+  uint64_t packets() const { return packets_; }
+
+private:
+  void open_next_file();
+  void on_message(const u_char *data, uint32_t len, const UdpPacket &packet);
+  bool wanted(uint32_t security_id, int64_t exchange_time) const;
+
+  void append(const md::OrderEvent &order, uint64_t pcap_ts,
+              uint64_t pcap_seq);
+  void append(const md::TradeEvent &trade, uint64_t pcap_ts,
+              uint64_t pcap_seq);
+  void append(const md::SnapshotEvent &snapshot, uint64_t pcap_ts,
+              uint64_t pcap_seq);
+
+  // the batch being filled for a type, started with its columns if needed
+  ColumnBatch &building(md::EventType kind);
+  // move the batch of a type to ready_ once full, or if it has any rows
+  void seal(md::EventType kind, bool full_only);
+
+  StreamOptions options_;
+  size_t next_file_{0};
+  std::unique_ptr<PcapReader> reader_;
+  // udp packets of the files before the current one, numbers stay unique
+  uint64_t seq_base_{0};
+  uint64_t packets_{0};
+
+  std::unique_ptr<md::ChannelPruner> pruner_;
+  md::FragmentMerger merger_;
+  std::vector<std::unique_ptr<md::MdPreprocessor>> processors_;
+  md::MdArbitrator arbitrator_;
+  md::BatchDecoder decoder_;
+  md::EventBatch batch_;
+
+  // indexed by EventType, order to snapshot
+  std::unique_ptr<ColumnBatch> building_[4];
+  std::deque<std::unique_ptr<ColumnBatch>> ready_;
+};
+} // namespace python
@@ -0,0 +1,797 @@
+// python module pcap_md, decoded captures as column batches
+//
+//   import pcap_md
+//   for batch in pcap_md.Reader(["a.pcap", "b.pcap"], stocks=[1, 2],
+//                               start="09:30:00", end="10:00:00"):
+//       prices = numpy.asarray(batch["price"])        # no copy
+//       table = pyarrow.record_batch(batch)           # no copy either
+//
+// a batch owns its columns. batch[name] is a read-only memoryview over one
+// of them, and the batch exports itself through the arrow c data interface
+// (__arrow_c_array__) as a struct array with one child per column. either
+// way the values are not copied and stay alive as long as any view does.
+#define PY_SSIZE_T_CLEAN
+#include <Python.h>
+
+#include "event_stream.h"
+
+#include <stdexcept>
+
+using namespace python;
+
+namespace {
+// arrow c data interface, from the arrow specification
+#ifndef ARROW_C_DATA_INTERFACE
+#define ARROW_C_DATA_INTERFACE
+
+struct ArrowSchema {
+  const char *format;
+  const char *name;
+  const char *metadata;
+  int64_t flags;
+  int64_t n_children;
+  struct ArrowSchema **children;
+  struct ArrowSchema *dictionary;
+  void (*release)(struct ArrowSchema *);
+  void *private_data;
+};
+
+struct ArrowArray {
+  int64_t length;
+  int64_t null_count;
+  int64_t offset;
+  int64_t n_buffers;
+  int64_t n_children;
+  const void **buffers;
+  struct ArrowArray **children;
+  struct ArrowArray *dictionary;
+  void (*release)(struct ArrowArray *);
+  void *private_data;
+};
+
+#endif // ARROW_C_DATA_INTERFACE
+
+const char *kind_name(md::EventType kind) {
+  switch (kind) {
+  case md::EventType::Order:
+    return "order";
+  case md::EventType::Trade:
+    return "trade";
+  default:
+    return "snapshot";
+  }
+}
+
+const char *arrow_format(char format) {
+  switch (format) {
+  case 'q':
+    return "l";
+  case 'Q':
+    return "L";
+  case 'I':
+    return "I";
+  case 'H':
+    return "S";
+  default:
+    // one byte fixed size binary, like the 'c' of the buffer
+    return "w:1";
+  }
+}
+
+// for the struct module, a view of the column keeps these
+const char *buffer_format(char format) {
+  switch (format) {
+  case 'q':
+    return "q";
+  case 'Q':
+    return "Q";
+  case 'I':
+    return "I";
+  case 'H':
+    return "H";
+  default:
+    return "c";
+  }
+}
+
+// "HH:MM:SS[.mmm]" exchange time as millis of the day, -1 if malformed
+int64_t parse_time(const std::string &str) {
+  int hours, minutes, seconds, millis = 0;
+  if (sscanf(str.c_str(), "%d:%d:%d.%d", &hours, &minutes, &seconds,
+             &millis) < 3) {
+    return -1;
+  }
+  return ((hours * 60 + minutes) * 60 + seconds) * 1000 + millis;
+}
+
+// c++ exceptions become python ones, returns nullptr for convenience
+PyObject *set_error(const std::exception &e) {
+  if (dynamic_cast<const std::invalid_argument *>(&e) != nullptr) {
+    PyErr_SetString(PyExc_ValueError, e.what());
+  } else if (dynamic_cast<const std::bad_alloc *>(&e) != nullptr) {
+    PyErr_NoMemory();
+  } else {
+    PyErr_SetString(PyExc_RuntimeError, e.what());
+  }
+  return nullptr;
+}
+
+// Batch
+
+struct BatchObject {
+  PyObject_HEAD ColumnBatch *batch;
+};
+
+// buffer exporter of one column, holds the batch alive
+struct ColumnObject {
+  PyObject_HEAD BatchObject *owner;
+  const Column *column;
+  Py_ssize_t shape;
+  Py_ssize_t stride;
+};
+
+PyTypeObject BatchType = {PyVarObject_HEAD_INIT(nullptr, 0)};
+PyTypeObject ColumnType = {PyVarObject_HEAD_INIT(nullptr, 0)};
+
+void batch_dealloc(BatchObject *self) {
+  delete self->batch;
+  Py_TYPE(self)->tp_free(reinterpret_cast<PyObject *>(self));
+}
+
+int column_getbuffer(ColumnObject *self, Py_buffer *view, int flags) {
+  if ((flags & PyBUF_WRITABLE) == PyBUF_WRITABLE) {
+    PyErr_SetString(PyExc_BufferError, "batch columns are read-only");
+    return -1;
+  }
+  const Column &column = *self->column;
+  view->obj = reinterpret_cast<PyObject *>(self);
+  Py_INCREF(self);
+  // an empty vector may have no storage, any non-null address will do
+  view->buf = const_cast<char *>(column.data.empty() ? "" : column.data.data());
+  view->len = column.data.size();
+  view->readonly = 1;
+  view->itemsize = column.itemsize;
+  view->format = (flags & PyBUF_FORMAT) == PyBUF_FORMAT
+                     ? const_cast<char *>(buffer_format(column.format))
+                     : nullptr;
+  view->ndim = 1;
+  view->shape = (flags & PyBUF_ND) == PyBUF_ND ? &self->shape : nullptr;
+  view->strides =
+      (flags & PyBUF_STRIDES) == PyBUF_STRIDES ? &self->stride : nullptr;
+  view->suboffsets = nullptr;
+  view->internal = nullptr;
+  return 0;
+}
+
+void column_dealloc(ColumnObject *self) {
+  Py_XDECREF(self->owner);
+  Py_TYPE(self)->tp_free(reinterpret_cast<PyObject *>(self));
+}
+
+PyBufferProcs column_buffer_procs = {
+    reinterpret_cast<getbufferproc>(column_getbuffer), nullptr};
+
+PyObject *column_view(BatchObject *self, const Column &column) {
+  auto *exporter = PyObject_New(ColumnObject, &ColumnType);
+  if (exporter == nullptr) {
+    return nullptr;
+  }
+  Py_INCREF(self);
+  exporter->owner = self;
+  exporter->column = &column;
+  exporter->shape = static_cast<Py_ssize_t>(self->batch->rows);
+  exporter->stride = column.itemsize;
+  PyObject *view =
+      PyMemoryView_FromObject(reinterpret_cast<PyObject *>(exporter));
+  Py_DECREF(exporter);
+  return view;
+}
+
+const Column *find_column(BatchObject *self, PyObject *key) {
+  const char *name = PyUnicode_AsUTF8(key);
+  if (name == nullptr) {
+    return nullptr;
+  }
+  for (const auto &column : self->batch->columns) {
+    if (column.name == name) {
+      return &column;
+    }
+  }
+  PyErr_SetObject(PyExc_KeyError, key);
+  return nullptr;
+}
+
+PyObject *batch_subscript(BatchObject *self, PyObject *key) {
+  const Column *column = find_column(self, key);
+  return column == nullptr ? nullptr : column_view(self, *column);
+}
+
+Py_ssize_t batch_length(BatchObject *self) {
+  return static_cast<Py_ssize_t>(self->batch->rows);
+}
+
+PyMappingMethods batch_mapping = {
+    reinterpret_cast<lenfunc>(batch_length),
+    reinterpret_cast<binaryfunc>(batch_subscript), nullptr};
+
+PyObject *batch_columns(BatchObject *self, PyObject *) {
+  PyObject *columns = PyDict_New();
+  if (columns == nullptr) {
+    return nullptr;
+  }
+  for (const auto &column : self->batch->columns) {
+    PyObject *view = column_view(self, column);
+    if (view == nullptr ||
+        PyDict_SetItemString(columns, column.name.c_str(), view) != 0) {
+      Py_XDECREF(view);
+      Py_DECREF(columns);
+      return nullptr;
+    }
+    Py_DECREF(view);
+  }
+  return columns;
+}
+
+// arrow export
+//
+// the batch is a struct array of its columns. schemas point at the column
+// names and arrays at the column data, so both hold a reference to the batch
+// until the consumer releases them
+
+struct ExportedSchema {
+  std::vector<ArrowSchema> children;
+  std::vector<ArrowSchema *> child_pointers;
+  PyObject *owner;
+};
+
+struct ExportedArray {
+  std::vector<ArrowArray> children;
+  std::vector<ArrowArray *> child_pointers;
+  std::vector<const void *> buffers;
+  const void *struct_buffers[1];
+  PyObject *owner;
+};
+
+void release_child_schema(ArrowSchema *schema) { schema->release = nullptr; }
+
+void release_schema(ArrowSchema *schema) {
+  auto *exported = static_cast<ExportedSchema *>(schema->private_data);
+  for (auto &child : exported->children) {
+    if (child.release != nullptr) {
+      child.release(&child);
+    }
+  }
+  // may come from any thread
+  PyGILState_STATE state = PyGILState_Ensure();
+  Py_DECREF(exported->owner);
+  PyGILState_Release(state);
+  delete exported;
+  schema->release = nullptr;
+}
+
+void release_child_array(ArrowArray *array) { array->release = nullptr; }
+
+void release_array(ArrowArray *array) {
+  auto *exported = static_cast<ExportedArray *>(array->private_data);
+  for (auto &child : exported->children) {
+    if (child.release != nullptr) {
+      child.release(&child);
+    }
+  }
+  PyGILState_STATE state = PyGILState_Ensure();
+  Py_DECREF(exported->owner);
+  PyGILState_Release(state);
+  delete exported;
+  array->release = nullptr;
+}
+
+void export_schema(BatchObject *self, ArrowSchema *schema) {
+  const auto &columns = self->batch->columns;
+  auto *exported = new ExportedSchema;
+  exported->children.resize(columns.size());
+  for (size_t i = 0; i < columns.size(); ++i) {
+    auto &child = exported->children[i];
+    child.format = arrow_format(columns[i].format);
+    child.name = columns[i].name.c_str();
+    child.metadata = nullptr;
+    child.flags = 0;
+    child.n_children = 0;
+    child.children = nullptr;
+    child.dictionary = nullptr;
+    child.release = release_child_schema;
+    child.private_data = nullptr;
+    exported->child_pointers.push_back(&child);
+  }
+  Py_INCREF(self);
+  exported->owner = reinterpret_cast<PyObject *>(self);
+
+  schema->format = "+s";
+  schema->name = "";
+  schema->metadata = nullptr;
+  schema->flags = 0;
+  schema->n_children = static_cast<int64_t>(columns.size());
+  schema->children = exported->child_pointers.data();
+  schema->dictionary = nullptr;
+  schema->release = release_schema;
+  schema->private_data = exported;
+}
+
+void export_array(BatchObject *self, ArrowArray *array) {
+  const auto &columns = self->batch->columns;
+  int64_t rows = static_cast<int64_t>(self->batch->rows);
+  auto *exported = new ExportedArray;
+  exported->children.resize(columns.size());
+  // a validity bitmap, absent, then the values of each column
+  exported->buffers.resize(2 * columns.size());
+  for (size_t i = 0; i < columns.size(); ++i) {
+    exported->buffers[2 * i] = nullptr;
+    exported->buffers[2 * i + 1] = columns[i].data.data();
+    auto &child = exported->children[i];
+    child.length = rows;
+    child.null_count = 0;
+    child.offset = 0;
+    child.n_buffers = 2;
+    child.n_children = 0;
+    child.buffers = &exported->buffers[2 * i];
+    child.children = nullptr;
+    child.dictionary = nullptr;
+    child.release = release_child_array;
+    child.private_data = nullptr;
+    exported->child_pointers.push_back(&child);
+  }
+  exported->struct_buffers[0] = nullptr;
+  Py_INCREF(self);
+  exported->owner = reinterpret_cast<PyObject *>(self);
+
+  array->length = rows;
+  array->null_count = 0;
+  array->offset = 0;
+  array->n_buffers = 1;
+  array->n_children = static_cast<int64_t>(columns.size());
+  array->buffers = exported->struct_buffers;
+  array->children = exported->child_pointers.data();
+  array->dictionary = nullptr;
+  array->release = release_array;
+  array->private_data = exported;
+}
+
+// capsules own their struct, released unless a consumer moved it out
+void schema_capsule_destructor(PyObject *capsule) {
+  auto *schema = static_cast<ArrowSchema *>(
+      PyCapsule_GetPointer(capsule, "arrow_schema"));
+  if (schema->release != nullptr) {
+    schema->release(schema);
+  }
+  delete schema;
+}
+
+void array_capsule_destructor(PyObject *capsule) {
+  auto *array =
+      static_cast<ArrowArray *>(PyCapsule_GetPointer(capsule, "arrow_array"));
+  if (array->release != nullptr) {
+    array->release(array);
+  }
+  delete array;
+}
+
+PyObject *schema_capsule(BatchObject *self) {
+  auto *schema = new ArrowSchema;
+  export_schema(self, schema);
+  PyObject *capsule =
+      PyCapsule_New(schema, "arrow_schema", schema_capsule_destructor);
+  if (capsule == nullptr) {
+    schema->release(schema);
+    delete schema;
+  }
+  return capsule;
+}
+
+PyObject *array_capsule(BatchObject *self) {
+  auto *array = new ArrowArray;
+  export_array(self, array);
+  PyObject *capsule =
+      PyCapsule_New(array, "arrow_array", array_capsule_destructor);
+  if (capsule == nullptr) {
+    array->release(array);
+    delete array;
+  }
+  return capsule;
+}
+
+PyObject *batch_arrow_c_schema(BatchObject *self, PyObject *) {
+  return schema_capsule(self);
+}
+
+// the requested schema is ignored, columns have one type each
+PyObject *batch_arrow_c_array(BatchObject *self, PyObject *args,
+                              PyObject *kwargs) {
+  static const char *keywords[] = {"requested_schema", nullptr};
+  PyObject *requested_schema = nullptr;
+  if (!PyArg_ParseTupleAndKeywords(args, kwargs, "|O",
+                                   const_cast<char **>(keywords),
+                                   &requested_schema)) {
+    return nullptr;
+  }
+  PyObject *schema = schema_capsule(self);
+  if (schema == nullptr) {
+    return nullptr;
+  }
+  PyObject *array = array_capsule(self);
+  if (array == nullptr) {
+    Py_DECREF(schema);
+    return nullptr;
+  }
+  PyObject *result = PyTuple_Pack(2, schema, array);
+  Py_DECREF(schema);
+  Py_DECREF(array);
+  return result;
+}
+
+PyObject *batch_get_kind(BatchObject *self, void *) {
+  return PyUnicode_FromString(kind_name(self->batch->kind));
+}
+
+PyObject *batch_get_num_rows(BatchObject *self, void *) {
+  return PyLong_FromSize_t(self->batch->rows);
+}
+
+PyObject *batch_get_column_names(BatchObject *self, void *) {
+  const auto &columns = self->batch->columns;
+  PyObject *names = PyTuple_New(columns.size());
+  if (names == nullptr) {
+    return nullptr;
+  }
+  for (size_t i = 0; i < columns.size(); ++i) {
+    PyObject *name = PyUnicode_FromString(columns[i].name.c_str());
+    if (name == nullptr) {
+      Py_DECREF(names);
+      return nullptr;
+    }
+    PyTuple_SET_ITEM(names, i, name);
+  }
+  return names;
+}
+
+PyObject *batch_repr(BatchObject *self) {
+  return PyUnicode_FromFormat("<pcap_md.Batch %s, %zu rows, %zu columns>",
+                              kind_name(self->batch->kind),
+                              self->batch->rows, self->batch->columns.size());
+}
+
+PyMethodDef batch_methods[] = {
+    {"columns", reinterpret_cast<PyCFunction>(batch_columns), METH_NOARGS,
+     "dict of column name -> read-only memoryview"},
+    {"__arrow_c_schema__", reinterpret_cast<PyCFunction>(batch_arrow_c_schema),
+     METH_NOARGS, "arrow schema capsule of the batch, a struct of columns"},
+    {"__arrow_c_array__", reinterpret_cast<PyCFunction>(batch_arrow_c_array),
+     METH_VARARGS | METH_KEYWORDS,
+     "(schema, array) capsules of the batch, the array shares its buffers"},
+    {nullptr, nullptr, 0, nullptr}};
+
+PyGetSetDef batch_getset[] = {
+    {"kind", reinterpret_cast<getter>(batch_get_kind), nullptr,
+     "'order', 'trade' or 'snapshot'", nullptr},
+    {"num_rows", reinterpret_cast<getter>(batch_get_num_rows), nullptr,
+     "number of rows", nullptr},
+    {"column_names", reinterpret_cast<getter>(batch_get_column_names),
+     nullptr, "names of the columns, in order", nullptr},
+    {nullptr, nullptr, nullptr, nullptr, nullptr}};
+
+PyObject *wrap_batch(std::unique_ptr<ColumnBatch> batch) {
+  auto *self = PyObject_New(BatchObject, &BatchType);
+  if (self == nullptr) {
+    return nullptr;
+  }
+  self->batch = batch.release();
+  return reinterpret_cast<PyObject *>(self);
+}
+
+// Reader
+
+struct ReaderObject {
+  PyObject_HEAD EventStream *stream;
+  // the stream is read without the GIL, set meanwhile so no other thread
+  // iterates or re-initialises it
+  bool busy;
+  // of the stream as of the last batch, read by other threads while busy
+  uint64_t packets;
+};
+
+PyTypeObject ReaderType = {PyVarObject_HEAD_INIT(nullptr, 0)};
+
+// a str or a sequence of them
+bool parse_files(PyObject *object, std::vector<std::string> &files) {
+  if (PyUnicode_Check(object) || PyBytes_Check(object)) {
+    PyObject *path = nullptr;
+    if (!PyUnicode_FSConverter(object, &path)) {
+      return false;
+    }
+    files.emplace_back(PyBytes_AS_STRING(path));
+    Py_DECREF(path);
+    return true;
+  }
+  PyObject *sequence = PySequence_Fast(object, "files must be a path or a "
+                                               "list of paths");
+  if (sequence == nullptr) {
+    return false;
+  }
+  bool ok = true;
+  for (Py_ssize_t i = 0; ok && i < PySequence_Fast_GET_SIZE(sequence); ++i) {
+    PyObject *path = nullptr;
+    ok = PyUnicode_FSConverter(PySequence_Fast_GET_ITEM(sequence, i), &path);
+    if (ok) {
+      files.emplace_back(PyBytes_AS_STRING(path));
+      Py_DECREF(path);
+    }
+  }
+  Py_DECREF(sequence);
+  return ok;
+}
+
+template <typename F> bool for_each_item(PyObject *object, F f) {
+  PyObject *iterator = PyObject_GetIter(object);
+  if (iterator == nullptr) {
+    return false;
+  }
+  bool ok = true;
+  while (PyObject *item = PyIter_Next(iterator)) {
+    ok = f(item);
+    Py_DECREF(item);
+    if (!ok) {
+      break;
+    }
+  }
+  Py_DECREF(iterator);
+  return ok && !PyErr_Occurred();
+}
+
+bool parse_time_argument(PyObject *object, const char *name, int64_t &millis) {
+  if (object == nullptr || object == Py_None) {
+    return true;
+  }
+  const char *str = PyUnicode_AsUTF8(object);
+  if (str == nullptr) {
+    return false;
+  }
+  millis = parse_time(str);
+  if (millis < 0) {
+    PyErr_Format(PyExc_ValueError, "%s must be HH:MM:SS[.mmm], got '%s'",
+                 name, str);
+    return false;
+  }
+  return true;
+}
+
+int reader_init(ReaderObject *self, PyObject *args, PyObject *kwargs) {
+  static const char *keywords[] = {
+      "files",  "stocks",     "start", "end",          "kinds",
+      "depth",  "batch_rows", "feeds", "netmask",      "prune_warmup",
+      nullptr};
+  PyObject *files = nullptr;
+  PyObject *stocks = Py_None;
+  PyObject *start = Py_None;
+  PyObject *end = Py_None;
+  PyObject *kinds = Py_None;
+  PyObject *feeds = Py_None;
+  int depth = 5;
+  Py_ssize_t batch_rows = 65536;
+  const char *netmask = nullptr;
+  unsigned int prune_warmup = 0;
+  if (!PyArg_ParseTupleAndKeywords(
+          args, kwargs, "O|OOOOinOzI", const_cast<char **>(keywords), &files,
+          &stocks, &start, &end, &kinds, &depth, &batch_rows, &feeds,
+          &netmask, &prune_warmup)) {
+    return -1;
+  }
+
+  StreamOptions options;
+  if (!parse_files(files, options.files)) {
+    return -1;
+  }
+  if (stocks != Py_None &&
+      !for_each_item(stocks, [&options](PyObject *item) {
+        unsigned long stock = PyLong_AsUnsignedLong(item);
+        if (PyErr_Occurred()) {
+          return false;
+        }
+        options.stocks.insert(static_cast<uint32_t>(stock));
+        return true;
+      })) {
+    return -1;
+  }
+  if (!parse_time_argument(start, "start", options.start_millis) ||
+      !parse_time_argument(end, "end", options.end_millis)) {
+    return -1;
+  }
+  if (kinds != Py_None) {
+    options.orders = options.trades = options.snapshots = false;
+    if (!for_each_item(kinds, [&options](PyObject *item) {
+          const char *kind = PyUnicode_AsUTF8(item);
+          if (kind == nullptr) {
+            return false;
+          }
+          std::string name(kind);
+          if (name == "order") {
+            options.orders = true;
+          } else if (name == "trade") {
+            options.trades = true;
+          } else if (name == "snapshot") {
+            options.snapshots = true;
+          } else {
+            PyErr_Format(PyExc_ValueError, "unknown kind '%s'", kind);
+            return false;
+          }
+          return true;
+        })) {
+      return -1;
+    }
+  }
+  if (feeds != Py_None) {
+    options.nets.clear();
+    if (!for_each_item(feeds, [&options](PyObject *item) {
+          const char *net = PyUnicode_AsUTF8(item);
+          if (net == nullptr) {
+            return false;
+          }
+          options.nets.emplace_back(net);
+          return true;
+        })) {
+      return -1;
+    }
+  }
+  if (netmask != nullptr) {
+    options.netmask = netmask;
+  }
+  if (batch_rows <= 0) {
+    PyErr_SetString(PyExc_ValueError, "batch_rows must be positive");
+    return -1;
+  }
+  options.depth = depth;
+  options.batch_rows = static_cast<size_t>(batch_rows);
+  options.prune_warmup = prune_warmup;
+
+  if (self->busy) {
+    PyErr_SetString(PyExc_RuntimeError,
+                    "Reader is being iterated in another thread");
+    return -1;
+  }
+  try {
+    std::unique_ptr<EventStream> stream(new EventStream(options));
+    delete self->stream;
+    self->stream = stream.release();
+    self->packets = 0;
+  } catch (const std::exception &e) {
+    set_error(e);
+    return -1;
+  }
+  return 0;
+}
+
+void reader_dealloc(ReaderObject *self) {
+  delete self->stream;
+  Py_TYPE(self)->tp_free(reinterpret_cast<PyObject *>(self));
+}
+
+PyObject *reader_iter(PyObject *self) {
+  Py_INCREF(self);
+  return self;
+}
+
+PyObject *reader_iternext(ReaderObject *self) {
+  if (self->stream == nullptr) {
+    PyErr_SetString(PyExc_RuntimeError, "Reader is not initialised");
+    return nullptr;
+  }
+  if (self->busy) {
+    PyErr_SetString(PyExc_RuntimeError,
+                    "Reader is being iterated in another thread");
+    return nullptr;
+  }
+  self->busy = true;
+  std::unique_ptr<ColumnBatch> batch;
+  // files are opened, and may turn out not to be captures, while reading
+  bool failed = false;
+  bool invalid = false;
+  std::string error;
+  Py_BEGIN_ALLOW_THREADS;
+  try {
+    batch = self->stream->next();
+  } catch (const std::invalid_argument &e) {
+    failed = invalid = true;
+    error = e.what();
+  } catch (const std::exception &e) {
+    failed = true;
+    error = e.what();
+  }
+  Py_END_ALLOW_THREADS;
+  self->busy = false;
+  self->packets = self->stream->packets();
+  if (failed) {
+    PyErr_SetString(invalid ? PyExc_OSError : PyExc_RuntimeError,
+                    error.c_str());
+    return nullptr;
+  }
+  if (!batch) {
+    // StopIteration
+    return nullptr;
+  }
+  return wrap_batch(std::move(batch));
+}
+
+PyObject *reader_get_packets(ReaderObject *self, void *) {
+  return PyLong_FromUnsignedLongLong(self->packets);
+}
+
+PyGetSetDef reader_getset[] = {
+    {"packets", reinterpret_cast<getter>(reader_get_packets), nullptr,
+     "packets read so far, from all files", nullptr},
+    {nullptr, nullptr, nullptr, nullptr, nullptr}};
+
+PyModuleDef module = {PyModuleDef_HEAD_INIT,
+                      "pcap_md",
+                      "market data captures decoded into column batches",
+                      -1,
+                      nullptr,
+                      nullptr,
+                      nullptr,
+                      nullptr,
+                      nullptr};
+} // namespace
+
+PyMODINIT_FUNC PyInit_pcap_md() {
+  ColumnType.tp_name = "pcap_md._Column";
+  ColumnType.tp_basicsize = sizeof(ColumnObject);
+  ColumnType.tp_dealloc = reinterpret_cast<destructor>(column_dealloc);
+  ColumnType.tp_as_buffer = &column_buffer_procs;
+  ColumnType.tp_flags = Py_TPFLAGS_DEFAULT;
+  ColumnType.tp_doc = "buffer of one batch column";
+
+  BatchType.tp_name = "pcap_md.Batch";
+  BatchType.tp_basicsize = sizeof(BatchObject);
+  BatchType.tp_dealloc = reinterpret_cast<destructor>(batch_dealloc);
+  BatchType.tp_repr = reinterpret_cast<reprfunc>(batch_repr);
+  BatchType.tp_as_mapping = &batch_mapping;
+  BatchType.tp_flags = Py_TPFLAGS_DEFAULT;
+  BatchType.tp_doc = "rows of one event type, column by column";
+  BatchType.tp_methods = batch_methods;
+  BatchType.tp_getset = batch_getset;
+
+  ReaderType.tp_name = "pcap_md.Reader";
+  ReaderType.tp_basicsize = sizeof(ReaderObject);
+  ReaderType.tp_dealloc = reinterpret_cast<destructor>(reader_dealloc);
+  ReaderType.tp_flags = Py_TPFLAGS_DEFAULT;
+  ReaderType.tp_doc =
+      "Reader(files, stocks=None, start=None, end=None, kinds=None, depth=5,\n"
+      "       batch_rows=65536, feeds=None, netmask=None, prune_warmup=0)\n"
+      "\n"
+      "iterates over Batch objects of orders, trades and snapshots decoded\n"
+      "from one capture or a list of them. stocks, start/end (exchange time\n"
+      "HH:MM:SS[.mmm], inclusive) and kinds filter rows before they are\n"
+      "written. prune_warmup > 0 also skips channels without the stocks.";
+  ReaderType.tp_init = reinterpret_cast<initproc>(reader_init);
+  ReaderType.tp_new = PyType_GenericNew;
+  ReaderType.tp_iter = reader_iter;
+  ReaderType.tp_iternext = reinterpret_cast<iternextfunc>(reader_iternext);
+  ReaderType.tp_getset = reader_getset;
+
+  if (PyType_Ready(&ColumnType) < 0 || PyType_Ready(&BatchType) < 0 ||
+      PyType_Ready(&ReaderType) < 0) {
+    return nullptr;
+  }
+  PyObject *m = PyModule_Create(&module);
+  if (m == nullptr) {
+    return nullptr;
+  }
+  Py_INCREF(&BatchType);
+  Py_INCREF(&ReaderType);
+  if (PyModule_AddObject(m, "Batch",
+                         reinterpret_cast<PyObject *>(&BatchType)) < 0 ||
+      PyModule_AddObject(m, "Reader",
+                         reinterpret_cast<PyObject *>(&ReaderType)) < 0) {
+    Py_DECREF(&BatchType);
+    Py_DECREF(&ReaderType);
+    Py_DECREF(m);
+    return nullptr;
+  }
+  return m;
+}
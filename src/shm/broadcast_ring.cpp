@@ -0,0 +1,162 @@
+#include "broadcast_ring.h"
+
+#include <cstring>
+#include <stdexcept>
+
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+using namespace shm;
+
+namespace {
+uint32_t round_up_to_power_of_2(uint32_t n) {
+  uint32_t result = 1;
+  while (result < n) {
+    result <<= 1;
+  }
+  return result;
+}
+
+std::string shm_path(const std::string &name) {
+  return name.empty() || name[0] != '/' ? "/" + name : name;
+}
+} // namespace
+
+Publisher::Publisher(std::string name, uint32_t capacity)
+    : name_(shm_path(name)) {
+  capacity = round_up_to_power_of_2(capacity);
+  mapped_size_ = sizeof(RingHeader) + sizeof(Slot) * capacity;
+
+  // replace any stale segment left by a previous run
+  shm_unlink(name_.c_str());
+  int fd = shm_open(name_.c_str(), O_CREAT | O_EXCL | O_RDWR, 0644);
+  if (fd < 0) {
+    throw std::runtime_error("cannot create shared memory " + name_);
+  }
+  if (ftruncate(fd, mapped_size_) != 0) {
+    close(fd);
+    shm_unlink(name_.c_str());
+    throw std::runtime_error("cannot resize shared memory " + name_);
+  }
+  void *addr =
+      mmap(nullptr, mapped_size_, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+  close(fd);
+  if (addr == MAP_FAILED) {
+    shm_unlink(name_.c_str());
+    throw std::runtime_error("cannot map shared memory " + name_);
+  }
+
+  // the segment is zero filled by ftruncate, i.e. every slot is empty
+  header_ = static_cast<RingHeader *>(addr);
+  slots_ = reinterpret_cast<Slot *>(static_cast<u_char *>(addr) +
+                                    sizeof(RingHeader));
+  header_->capacity = capacity;
+  header_->version = RingHeader::VERSION;
+  header_->write_seq.store(0, std::memory_order_relaxed);
+  // subscribers check magic last
+  std::atomic_thread_fence(std::memory_order_release);
+  header_->magic = RingHeader::MAGIC;
+}
+
+Publisher::~Publisher() {
+  munmap(header_, mapped_size_);
+  shm_unlink(name_.c_str());
+}
+
+void Publisher::publish(md::EventType type, const void *data, uint32_t size,
+                        uint64_t pcap_ts, uint64_t pcap_seq) {
+  uint64_t seq = header_->write_seq.load(std::memory_order_relaxed);
+  Slot &slot = slots_[seq & (header_->capacity - 1)];
+
+  // mark the slot as being written before touching the payload
+  slot.seq.store(0, std::memory_order_relaxed);
+  std::atomic_thread_fence(std::memory_order_release);
+
+  slot.type = type;
+  slot.size = size;
+  slot.pcap_ts = pcap_ts;
+  slot.pcap_seq = pcap_seq;
+  std::memcpy(slot.payload, data, size);
+
+  slot.seq.store(seq + 1, std::memory_order_release);
+  header_->write_seq.store(seq + 1, std::memory_order_release);
+}
+
+Subscriber::Subscriber(std::string name) {
+  std::string path = shm_path(name);
+  int fd = shm_open(path.c_str(), O_RDONLY, 0);
+  if (fd < 0) {
+    throw std::runtime_error("cannot open shared memory " + path);
+  }
+  struct stat st;
+  if (fstat(fd, &st) != 0 ||
+      static_cast<size_t>(st.st_size) < sizeof(RingHeader)) {
+    close(fd);
+    throw std::runtime_error("invalid shared memory " + path);
+  }
+  mapped_size_ = st.st_size;
+  void *addr = mmap(nullptr, mapped_size_, PROT_READ, MAP_SHARED, fd, 0);
+  close(fd);
+  if (addr == MAP_FAILED) {
+    throw std::runtime_error("cannot map shared memory " + path);
+  }
+
+  header_ = static_cast<const RingHeader *>(addr);
+  if (header_->magic != RingHeader::MAGIC ||
+      header_->version != RingHeader::VERSION ||
+      mapped_size_ < sizeof(RingHeader) + sizeof(Slot) * header_->capacity) {
+    munmap(addr, mapped_size_);
+    throw std::runtime_error("not a market data ring: " + path);
+  }
+  std::atomic_thread_fence(std::memory_order_acquire);
+
+  slots_ = reinterpret_cast<const Slot *>(static_cast<const u_char *>(addr) +
+                                          sizeof(RingHeader));
+  mask_ = header_->capacity - 1;
+  cursor_ = header_->write_seq.load(std::memory_order_acquire);
+}
+
+Subscriber::~Subscriber() {
+  munmap(const_cast<RingHeader *>(header_), mapped_size_);
+}
+
+Subscriber::Status Subscriber::poll(Record &record) {
+  uint64_t write_seq = header_->write_seq.load(std::memory_order_acquire);
+  if (cursor_ >= write_seq) {
+    return Status::Empty;
+  }
+
+  const Slot &slot = slots_[cursor_ & mask_];
+  uint64_t before = slot.seq.load(std::memory_order_acquire);
+  if (before == cursor_ + 1) {
+    record.type = slot.type;
+    record.size = slot.size;
+    record.pcap_ts = slot.pcap_ts;
+    record.pcap_seq = slot.pcap_seq;
+    std::memcpy(record.payload, slot.payload,
+                record.size < Slot::PAYLOAD_SIZE ? record.size
+                                                 : Slot::PAYLOAD_SIZE);
+
+    // the publisher may have lapped us while copying
+    std::atomic_thread_fence(std::memory_order_acquire);
+    if (slot.seq.load(std::memory_order_relaxed) == before) {
+      cursor_ += 1;
+      return Status::Ok;
+    }
+  }
+
+  // the slot has been (or is being) reused, skip to the oldest record which
+  // is safe to read, leaving one slot of headroom for the writer
+  write_seq = header_->write_seq.load(std::memory_order_acquire);
+  uint64_t oldest = write_seq > mask_ ? write_seq - mask_ : 0;
+  if (oldest > cursor_) {
+    lost_ += oldest - cursor_;
+    cursor_ = oldest;
+  } else {
+    lost_ += 1;
+    cursor_ += 1;
+  }
+  return Status::Overrun;
+}
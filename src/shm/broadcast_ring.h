@@ -0,0 +1,136 @@
+#pragma once
+
+#include "../md/event.h"
+
+#include <atomic>
+#include <cstdint>
+#include <string>
+
+namespace shm {
+// a broadcast ring in a named shared memory segment (/dev/shm/<name>)
+//
+// layout: RingHeader | Slot[capacity]
+//
+// there is a single publisher and any number of subscribers. subscribers only
+// map the segment read-only and keep their own cursor, so they never slow the
+// publisher down. a slow subscriber is lapped instead, which it detects by
+// checking the slot sequence before and after copying (seqlock style).
+struct RingHeader {
+  static const uint64_t MAGIC = 0x474e4952444d4450; // "PDMDRING"
+  static const uint32_t VERSION = 1;
+
+  uint64_t magic;
+  uint32_t version;
+  // number of slots, power of 2
+  uint32_t capacity;
+  // total number of records published, i.e. the next record to write
+  alignas(64) std::atomic<uint64_t> write_seq;
+};
+
+struct alignas(64) Slot {
+  static const uint32_t PAYLOAD_SIZE = 448;
+
+  // 1 + sequence of the record in this slot, 0 while being written
+  std::atomic<uint64_t> seq;
+  md::EventType type;
+  uint32_t size;
+  uint64_t pcap_ts;
+  uint64_t pcap_seq;
+  alignas(8) u_char payload[PAYLOAD_SIZE];
+};
+
+static_assert(sizeof(md::SnapshotEvent) <= Slot::PAYLOAD_SIZE,
+              "snapshot event does not fit into a slot");
+
+// a copy of one slot, owned by the subscriber
+struct Record {
+  md::EventType type;
+  uint32_t size;
+  uint64_t pcap_ts;
+  uint64_t pcap_seq;
+  alignas(8) u_char payload[Slot::PAYLOAD_SIZE];
+
+  const md::OrderEvent &order() const {
+    return *reinterpret_cast<const md::OrderEvent *>(payload);
+  }
+  const md::TradeEvent &trade() const {
+    return *reinterpret_cast<const md::TradeEvent *>(payload);
+  }
+  const md::SnapshotEvent &snapshot() const {
+    return *reinterpret_cast<const md::SnapshotEvent *>(payload);
+  }
+};
+
+class Publisher {
+public:
+  // creates (or replaces) the segment, capacity is rounded up to power of 2
+  Publisher(std::string name, uint32_t capacity);
+  ~Publisher();
+
+  Publisher(const Publisher &) = delete;
+  Publisher &operator=(const Publisher &) = delete;
+
+  void publish(const md::OrderEvent &event, uint64_t pcap_ts,
+               uint64_t pcap_seq) {
+    publish(md::EventType::Order, &event, sizeof(event), pcap_ts, pcap_seq);
+  }
+
+  void publish(const md::TradeEvent &event, uint64_t pcap_ts,
+               uint64_t pcap_seq) {
+    publish(md::EventType::Trade, &event, sizeof(event), pcap_ts, pcap_seq);
+  }
+
+  void publish(const md::SnapshotEvent &event, uint64_t pcap_ts,
+               uint64_t pcap_seq) {
+    publish(md::EventType::Snapshot, &event, sizeof(event), pcap_ts,
+            pcap_seq);
+  }
+
+  uint64_t published() const {
+    return header_->write_seq.load(std::memory_order_relaxed);
+  }
+
+private:
+  void publish(md::EventType type, const void *data, uint32_t size,
+               uint64_t pcap_ts, uint64_t pcap_seq);
+
+  std::string name_;
+  size_t mapped_size_{0};
+  RingHeader *header_{nullptr};
+  Slot *slots_{nullptr};
+};
+
+class Subscriber {
+public:
+  enum class Status {
+    Ok,
+    // nothing new yet
+    Empty,
+    // we were lapped by the publisher, records were lost and the cursor has
+    // been moved forward to the oldest record still available
+    Overrun,
+  };
+
+  // attaches to an existing segment, reading starts from the next record
+  explicit Subscriber(std::string name);
+  ~Subscriber();
+
+  Subscriber(const Subscriber &) = delete;
+  Subscriber &operator=(const Subscriber &) = delete;
+
+  Status poll(Record &record);
+
+  uint64_t cursor() const { return cursor_; }
+  // total number of records lost to overrun
+  uint64_t lost() const { return lost_; }
+
+private:
+  size_t mapped_size_{0};
+  const RingHeader *header_{nullptr};
+  const Slot *slots_{nullptr};
+  uint64_t mask_{0};
+
+  uint64_t cursor_{0};
+  uint64_t lost_{0};
+};
+} // namespace shm
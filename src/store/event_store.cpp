@@ -0,0 +1,232 @@
+#include "event_store.h"
+#include "../md/utils.h"
+
+#include <algorithm>
+#include <cerrno>
+#include <cstring>
+#include <stdexcept>
+
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+using namespace store;
+
+namespace {
+size_t padded(size_t size) { return (size + 7) & ~static_cast<size_t>(7); }
+
+bool write_all(int fd, const void *data, size_t size) {
+  const char *p = static_cast<const char *>(data);
+  while (size > 0) {
+    ssize_t n = write(fd, p, size);
+    if (n < 0 && errno == EINTR) {
+      continue;
+    }
+    if (n <= 0) {
+      return false;
+    }
+    p += n;
+    size -= n;
+  }
+  return true;
+}
+
+// a new file starts with the header, an existing one is appended to
+bool append_file(const std::string &path, bool create, Kind kind,
+                 const void *data, size_t size) {
+  int flags = O_WRONLY | O_CREAT | O_APPEND | (create ? O_TRUNC : 0);
+  int fd = open(path.c_str(), flags, 0644);
+  if (fd < 0) {
+    return false;
+  }
+  bool ok = true;
+  if (create) {
+    FileHeader header{FileHeader::MAGIC, FileHeader::VERSION, kind};
+    ok = write_all(fd, &header, sizeof(header));
+  }
+  ok = ok && write_all(fd, data, size);
+  return close(fd) == 0 && ok;
+}
+
+// read-only mapping of a whole file, pages are only read when touched
+class Mapping {
+public:
+  explicit Mapping(const std::string &path) {
+    int fd = open(path.c_str(), O_RDONLY);
+    if (fd < 0) {
+      return;
+    }
+    struct stat st;
+    if (fstat(fd, &st) == 0 && st.st_size > 0) {
+      void *addr = mmap(nullptr, st.st_size, PROT_READ, MAP_SHARED, fd, 0);
+      if (addr != MAP_FAILED) {
+        data_ = static_cast<const char *>(addr);
+        size_ = st.st_size;
+      }
+    }
+    close(fd);
+  }
+
+  ~Mapping() {
+    if (data_ != nullptr) {
+      munmap(const_cast<char *>(data_), size_);
+    }
+  }
+
+  Mapping(const Mapping &) = delete;
+  Mapping &operator=(const Mapping &) = delete;
+
+  const char *data() const { return data_; }
+  uint64_t size() const { return size_; }
+
+private:
+  const char *data_{nullptr};
+  uint64_t size_{0};
+};
+
+bool valid_header(const char *data, uint64_t size, Kind kind) {
+  if (data == nullptr || size < sizeof(FileHeader)) {
+    return false;
+  }
+  const auto &header = *reinterpret_cast<const FileHeader *>(data);
+  return header.magic == FileHeader::MAGIC &&
+         header.version == FileHeader::VERSION && header.kind == kind;
+}
+} // namespace
+
+std::string store::segment_path(const std::string &dir, uint32_t security_id,
+                                Kind kind) {
+  return dir + '/' + std::to_string(security_id) +
+         (kind == Kind::Tick ? ".tick" : ".snap");
+}
+
+Writer::Writer(std::string dir, size_t buffer_size)
+    : dir_(dir), buffer_size_(buffer_size) {
+  if (mkdir(dir_.c_str(), 0755) != 0 && errno != EEXIST) {
+    throw std::runtime_error("cannot create store directory " + dir_);
+  }
+}
+
+void Writer::append(Kind kind, uint32_t security_id, int64_t time,
+                    md::EventType type, const void *event, uint32_t size,
+                    uint64_t pcap_ts, uint64_t pcap_seq) {
+  uint64_t key = static_cast<uint64_t>(security_id) << 32 |
+                 static_cast<uint32_t>(kind);
+  auto found = segments_.find(key);
+  if (found == segments_.end()) {
+    found = segments_.emplace(key, Segment()).first;
+    found->second.path = segment_path(dir_, security_id, kind);
+    found->second.kind = kind;
+    stats_.segments += 1;
+  }
+  Segment &segment = found->second;
+
+  int64_t millis = md::exchange_time_to_millis(time);
+  if (millis > segment.max_millis) {
+    segment.max_millis = millis;
+  }
+  if (segment.records % IndexEntry::INDEX_INTERVAL == 0) {
+    segment.index.push_back(IndexEntry{segment.max_millis, segment.size});
+  }
+
+  RecordHeader header{time, pcap_ts, pcap_seq, type, size};
+  const char *p = reinterpret_cast<const char *>(&header);
+  segment.data.insert(segment.data.end(), p, p + sizeof(header));
+  p = static_cast<const char *>(event);
+  segment.data.insert(segment.data.end(), p, p + size);
+  segment.data.resize(segment.data.size() + padded(size) - size, 0);
+
+  uint64_t bytes = sizeof(header) + padded(size);
+  segment.size += bytes;
+  segment.records += 1;
+  stats_.records += 1;
+  stats_.bytes += bytes;
+
+  if (segment.data.size() >= buffer_size_) {
+    failed_ = !flush(segment) || failed_;
+  }
+}
+
+bool Writer::flush(Segment &segment) {
+  if (segment.data.empty()) {
+    return true;
+  }
+  // data first, so the index never points past it
+  bool ok = append_file(segment.path, !segment.created, segment.kind,
+                        segment.data.data(), segment.data.size()) &&
+            append_file(segment.path + ".idx", !segment.created, segment.kind,
+                        segment.index.data(),
+                        segment.index.size() * sizeof(IndexEntry));
+  segment.created = true;
+  segment.data.clear();
+  segment.index.clear();
+  return ok;
+}
+
+bool Writer::flush() {
+  for (auto &kv : segments_) {
+    failed_ = !flush(kv.second) || failed_;
+  }
+  return !failed_;
+}
+
+uint64_t Reader::query(uint32_t security_id, Kind kind, int64_t from_millis,
+                       int64_t to_millis, const Handler &handler) const {
+  std::string path = segment_path(dir_, security_id, kind);
+
+  Mapping index(path + ".idx");
+  if (!valid_header(index.data(), index.size(), kind)) {
+    return 0;
+  }
+  const auto *entries =
+      reinterpret_cast<const IndexEntry *>(index.data() + sizeof(FileHeader));
+  size_t entry_count = (index.size() - sizeof(FileHeader)) / sizeof(IndexEntry);
+
+  // every record up to an entry with millis < from_millis is too early
+  const IndexEntry *first = std::lower_bound(
+      entries, entries + entry_count, from_millis,
+      [](const IndexEntry &entry, int64_t millis) {
+        return entry.millis < millis;
+      });
+  uint64_t offset =
+      first == entries ? sizeof(FileHeader) : (first - 1)->offset;
+  // times step back slightly, a record past to_millis may be followed by
+  // ones within the range. the scan goes on to the first entry beyond it
+  // and through its interval, as its maximum may be past by one record only
+  const IndexEntry *last = std::upper_bound(
+      first, entries + entry_count, to_millis,
+      [](int64_t millis, const IndexEntry &entry) {
+        return millis < entry.millis;
+      });
+  if (last != entries + entry_count) {
+    ++last;
+  }
+
+  Mapping segment(path);
+  if (!valid_header(segment.data(), segment.size(), kind) ||
+      offset > segment.size()) {
+    return 0;
+  }
+  const char *p = segment.data() + offset;
+  const char *end = segment.data() + segment.size();
+  if (last != entries + entry_count && last->offset < segment.size()) {
+    end = segment.data() + last->offset;
+  }
+  uint64_t count = 0;
+  while (p + sizeof(RecordHeader) <= end) {
+    const auto &record = *reinterpret_cast<const RecordHeader *>(p);
+    size_t record_size = sizeof(RecordHeader) + padded(record.size);
+    if (p + record_size > end) {
+      // torn by a run which did not finish
+      break;
+    }
+    int64_t millis = md::exchange_time_to_millis(record.time);
+    if (millis >= from_millis && millis <= to_millis) {
+      handler(record);
+      count += 1;
+    }
+    p += record_size;
+  }
+  return count;
+}
@@ -0,0 +1,149 @@
+#pragma once
+
+#include "../md/event.h"
+
+#include <cstdint>
+#include <functional>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+namespace store {
+// per-security append-only segments of normalised events with a sparse
+// time index, one directory per day
+//
+// <dir>/<security_id>.tick holds orders and trades, <security_id>.snap holds
+// snapshots, each in arbitration order, which is exchange time order within
+// a kind. a segment is a FileHeader followed by records:
+//   RecordHeader | event (md::OrderEvent, ...) padded to 8 bytes
+// <segment>.idx is a FileHeader followed by an IndexEntry for every
+// INDEX_INTERVAL-th record. a query maps the index and the one segment it
+// needs, binary searches the index for the entries around the range and
+// scans the records between them.
+enum class Kind : uint32_t {
+  Tick = 1,
+  Snapshot = 2,
+};
+
+struct FileHeader {
+  static const uint64_t MAGIC = 0x45524f54534d4450; // "PDMSTORE"
+  static const uint32_t VERSION = 1;
+
+  uint64_t magic;
+  uint32_t version;
+  Kind kind;
+};
+
+struct RecordHeader {
+  // exchange time, YYYYMMDDHHMMSSsss
+  int64_t time;
+  uint64_t pcap_ts;
+  uint64_t pcap_seq;
+  md::EventType type;
+  // of the event following the header, without padding
+  uint32_t size;
+
+  const md::OrderEvent &order() const {
+    return *reinterpret_cast<const md::OrderEvent *>(this + 1);
+  }
+  const md::TradeEvent &trade() const {
+    return *reinterpret_cast<const md::TradeEvent *>(this + 1);
+  }
+  const md::SnapshotEvent &snapshot() const {
+    return *reinterpret_cast<const md::SnapshotEvent *>(this + 1);
+  }
+};
+
+struct IndexEntry {
+  static const uint32_t INDEX_INTERVAL = 64;
+
+  // latest exchange time of the records up to the indexed one, in
+  // milliseconds since midnight, so it never decreases
+  int64_t millis;
+  // of the indexed record in the segment
+  uint64_t offset;
+};
+
+std::string segment_path(const std::string &dir, uint32_t security_id,
+                         Kind kind);
+
+class Writer {
+public:
+  struct Stats {
+    uint64_t segments{0};
+    uint64_t records{0};
+    uint64_t bytes{0};
+  };
+
+  // creates dir if needed, segments written replace those of previous runs
+  // segment data is buffered up to buffer_size before it is appended
+  explicit Writer(std::string dir, size_t buffer_size = 8192);
+
+  ~Writer() { flush(); }
+
+  void append(const md::OrderEvent &event, uint64_t pcap_ts,
+              uint64_t pcap_seq) {
+    append(Kind::Tick, event.security_id, event.transaction_time,
+           md::EventType::Order, &event, sizeof(event), pcap_ts, pcap_seq);
+  }
+
+  void append(const md::TradeEvent &event, uint64_t pcap_ts,
+              uint64_t pcap_seq) {
+    append(Kind::Tick, event.security_id, event.transaction_time,
+           md::EventType::Trade, &event, sizeof(event), pcap_ts, pcap_seq);
+  }
+
+  void append(const md::SnapshotEvent &event, uint64_t pcap_ts,
+              uint64_t pcap_seq) {
+    append(Kind::Snapshot, event.security_id, event.orig_time,
+           md::EventType::Snapshot, &event, sizeof(event), pcap_ts, pcap_seq);
+  }
+
+  // write out all buffers, returns false if any write failed
+  bool flush();
+
+  const Stats &stats() const { return stats_; }
+
+private:
+  struct Segment {
+    std::string path;
+    Kind kind;
+    bool created{false};
+    // bytes of the segment, on disk and buffered
+    uint64_t size{sizeof(FileHeader)};
+    uint64_t records{0};
+    int64_t max_millis{0};
+    std::vector<char> data;
+    std::vector<IndexEntry> index;
+  };
+
+  void append(Kind kind, uint32_t security_id, int64_t time,
+              md::EventType type, const void *event, uint32_t size,
+              uint64_t pcap_ts, uint64_t pcap_seq);
+
+  bool flush(Segment &segment);
+
+  std::string dir_;
+  size_t buffer_size_;
+  bool failed_{false};
+  // key: security_id << 32 | kind
+  std::unordered_map<uint64_t, Segment> segments_;
+  Stats stats_;
+};
+
+class Reader {
+public:
+  using Handler = std::function<void(const RecordHeader &)>;
+
+  explicit Reader(std::string dir) : dir_(dir) {}
+
+  // calls handler for each record of the security with exchange time in
+  // [from_millis, to_millis], in milliseconds since midnight, in segment
+  // order. returns the number of records, a missing segment has none
+  uint64_t query(uint32_t security_id, Kind kind, int64_t from_millis,
+                 int64_t to_millis, const Handler &handler) const;
+
+private:
+  std::string dir_;
+};
+} // namespace store
@@ -0,0 +1,36 @@
+#include "../csv/merger.h"
+
+#include <iostream>
+#include <unistd.h>
+
+// merge per-pcap outputs of one type, e.g. pcap*_order.csv, into one
+// time-ordered stream
+int main(int argc, char *argv[]) {
+  // 512 inputs take about 128 MiB
+  size_t buffer_kib = 256;
+  bool valid = true;
+  int opt;
+  while ((opt = getopt(argc, argv, "b:")) != -1) {
+    switch (opt) {
+    case 'b':
+      buffer_kib = std::stoul(optarg);
+      break;
+    default:
+      valid = false;
+    }
+  }
+  if (!valid || argc - optind < 2) {
+    std::cerr << "Usage: " << argv[0]
+              << " [-b <buffer KiB per file>] <output csv> <input csv>...\n";
+    return 1;
+  }
+
+  std::vector<std::string> inputs(argv + optind + 1, argv + argc);
+  csv::Merger merger(inputs, argv[optind], buffer_kib * 1024);
+  int result = merger.merge();
+
+  const auto &stats = merger.stats();
+  std::cout << stats.lines_read << " lines read, " << stats.lines_written
+            << " written, " << stats.duplicates << " duplicates dropped\n";
+  return result;
+}
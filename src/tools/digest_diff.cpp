@@ -0,0 +1,26 @@
+#include "../csv/digest.h"
+
+#include <fstream>
+#include <iostream>
+
+// compare <prefix>_digest.csv of two runs, e.g. before and after a decoder
+// change, exits with 1 when they differ
+int main(int argc, char *argv[]) {
+  if (argc != 3) {
+    std::cerr << "Usage: " << argv[0] << " <digest csv> <digest csv>\n";
+    return 2;
+  }
+
+  std::ifstream a(argv[1]);
+  std::ifstream b(argv[2]);
+  if (!a || !b) {
+    std::cerr << "cannot open " << (a ? argv[2] : argv[1]) << '\n';
+    return 2;
+  }
+
+  if (csv::compare_digests(a, b, std::cout)) {
+    std::cout << "identical\n";
+    return 0;
+  }
+  return 1;
+}
@@ -0,0 +1,37 @@
+#include "../io/gzip_frames.h"
+
+#include <iostream>
+#include <string>
+
+// list the frames of a csv written with -z, or print one of them without
+// decompressing the ones before it
+int main(int argc, char *argv[]) {
+  if (argc != 2 && argc != 3) {
+    std::cerr << "Usage: " << argv[0] << " <csv.gz> [<frame>]\n"
+              << "  without a frame, prints frame,offset,size,uncompressed\n";
+    return 1;
+  }
+
+  auto frames = io::list_frames(argv[1]);
+  if (argc == 2) {
+    std::cout << "frame,offset,size,uncompressed\n";
+    for (size_t i = 0; i < frames.size(); ++i) {
+      std::cout << i << ',' << frames[i].offset << ',' << frames[i].size << ','
+                << frames[i].uncompressed << '\n';
+    }
+    return 0;
+  }
+
+  size_t index = std::stoul(argv[2]);
+  if (index >= frames.size()) {
+    std::cerr << argv[1] << " has " << frames.size() << " frames\n";
+    return 1;
+  }
+  std::string text;
+  if (!io::read_frame(argv[1], frames[index], text)) {
+    std::cerr << "cannot read frame " << index << '\n';
+    return 1;
+  }
+  std::cout << text;
+  return 0;
+}
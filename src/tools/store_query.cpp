@@ -0,0 +1,111 @@
+#include "../md/utils.h"
+#include "../store/event_store.h"
+
+#include <chrono>
+#include <cstdio>
+#include <iostream>
+#include <string>
+#include <unistd.h>
+
+namespace {
+// HH:MM:SS[.mmm] to milliseconds since midnight, -1 if malformed
+int64_t parse_time(const std::string &str) {
+  int hours, minutes, seconds, millis = 0;
+  if (sscanf(str.c_str(), "%d:%d:%d.%d", &hours, &minutes, &seconds,
+             &millis) < 3) {
+    return -1;
+  }
+  return ((hours * 60 + minutes) * 60 + seconds) * 1000 + millis;
+}
+
+void print(const store::RecordHeader &record) {
+  std::cout << md::timestamp_to_string(record.time) << ',' << record.pcap_ts
+            << ',' << record.pcap_seq << ',';
+  switch (record.type) {
+  case md::EventType::Order: {
+    const auto &order = record.order();
+    std::cout << "order," << order.channel_no << ',' << order.appl_seq_num
+              << ',' << order.side << ',' << order.order_type << ','
+              << order.price << ',' << order.quantity;
+    break;
+  }
+  case md::EventType::Trade: {
+    const auto &trade = record.trade();
+    std::cout << "trade," << trade.channel_no << ',' << trade.appl_seq_num
+              << ',' << trade.execute_type << ',' << trade.price << ','
+              << trade.quantity << ',' << trade.bid_appl_seq_num << ','
+              << trade.offer_appl_seq_num;
+    break;
+  }
+  case md::EventType::Snapshot: {
+    const auto &snapshot = record.snapshot();
+    std::cout << "snapshot," << snapshot.channel_no << ','
+              << snapshot.total_trade_num << ','
+              << snapshot.total_trade_volume << ','
+              << snapshot.total_trade_value << ','
+              << snapshot.latest_trade_price << ',';
+    // best levels as price:quantity
+    std::cout << snapshot.bids[0].price << ':' << snapshot.bids[0].quantity
+              << ',' << snapshot.asks[0].price << ':'
+              << snapshot.asks[0].quantity;
+    break;
+  }
+  default:
+    std::cout << "type " << static_cast<uint32_t>(record.type);
+  }
+  std::cout << '\n';
+}
+} // namespace
+
+// orders, trades and snapshots of one security from a store written with -S
+int main(int argc, char *argv[]) {
+  bool ticks = true;
+  bool snapshots = true;
+  bool valid = true;
+  int opt;
+  while ((opt = getopt(argc, argv, "ts")) != -1) {
+    switch (opt) {
+    case 't':
+      snapshots = false;
+      break;
+    case 's':
+      ticks = false;
+      break;
+    default:
+      valid = false;
+    }
+  }
+  int64_t from = 0;
+  int64_t to = 24 * 3600 * 1000;
+  if (argc - optind == 4) {
+    from = parse_time(argv[optind + 2]);
+    to = parse_time(argv[optind + 3]);
+  }
+  if (!valid || (argc - optind != 2 && argc - optind != 4) || from < 0 ||
+      to < 0) {
+    std::cerr << "Usage: " << argv[0]
+              << " [-t | -s] <store dir> <security id> [<from> <to>]\n"
+              << "  times are HH:MM:SS[.mmm] exchange time, inclusive\n"
+              << "  orders and trades are listed before snapshots\n"
+              << "  -t  orders and trades only\n"
+              << "  -s  snapshots only\n";
+    return 1;
+  }
+
+  store::Reader reader(argv[optind]);
+  uint32_t security_id = std::stoul(argv[optind + 1]);
+
+  std::cout << "time,clockAtArrival,sequenceNo,type,channel,...\n";
+  auto start = std::chrono::steady_clock::now();
+  uint64_t count = 0;
+  if (ticks) {
+    count += reader.query(security_id, store::Kind::Tick, from, to, print);
+  }
+  if (snapshots) {
+    count += reader.query(security_id, store::Kind::Snapshot, from, to, print);
+  }
+  std::chrono::duration<double, std::milli> elapsed =
+      std::chrono::steady_clock::now() - start;
+  std::cerr << count << " records in " << elapsed.count() << " ms\n";
+  return 0;
+}